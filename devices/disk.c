@@ -7,6 +7,8 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -208,6 +210,8 @@ disk_sector_t disk_size(struct disk* d)
    per-disk locking is unneeded. */
 void disk_read(struct disk* d, disk_sector_t sec_no, void* buffer)
 {
+    struct thread* t = thread_current();
+    uint64_t start = rdtsc();
     struct channel* c;
 
     ASSERT(d != NULL);
@@ -223,6 +227,8 @@ void disk_read(struct disk* d, disk_sector_t sec_no, void* buffer)
     input_sector(c, buffer);
     d->read_cnt++;
     lock_release(&c->lock);
+    t->disk_read_cnt++;
+    t->disk_cycles += rdtsc() - start;
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -232,6 +238,8 @@ void disk_read(struct disk* d, disk_sector_t sec_no, void* buffer)
    per-disk locking is unneeded. */
 void disk_write(struct disk* d, disk_sector_t sec_no, const void* buffer)
 {
+    struct thread* t = thread_current();
+    uint64_t start = rdtsc();
     struct channel* c;
 
     ASSERT(d != NULL);
@@ -247,6 +255,7 @@ void disk_write(struct disk* d, disk_sector_t sec_no, const void* buffer)
     sema_down(&c->completion_wait);
     d->write_cnt++;
     lock_release(&c->lock);
+    t->disk_cycles += rdtsc() - start;
 }
 
 /* Disk detection and identification. */
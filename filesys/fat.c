@@ -3,6 +3,8 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/synch.h"
+#include "threads/vmalloc.h"
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -53,7 +55,7 @@ void fat_init(void)
 
 void fat_open(void)
 {
-    fat_fs->fat = calloc(fat_fs->fat_length, sizeof(cluster_t));
+    fat_fs->fat = vmalloc(PAL_ZERO, DIV_ROUND_UP(fat_fs->fat_length * sizeof(cluster_t), PGSIZE));
     if (fat_fs->fat == NULL)
         PANIC("FAT load failed");
 
@@ -118,7 +120,7 @@ void fat_create(void)
     fat_fs_init();
 
     // Create FAT table
-    fat_fs->fat = calloc(fat_fs->fat_length, sizeof(cluster_t));
+    fat_fs->fat = vmalloc(PAL_ZERO, DIV_ROUND_UP(fat_fs->fat_length * sizeof(cluster_t), PGSIZE));
     if (fat_fs->fat == NULL)
         PANIC("FAT creation failed");
 
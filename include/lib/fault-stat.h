@@ -0,0 +1,41 @@
+#ifndef __LIB_FAULT_STAT_H
+#define __LIB_FAULT_STAT_H
+
+#include <stdint.h>
+
+/* Classes of page faults, as vm_try_handle_fault() counts them. */
+enum fault_class {
+    FAULT_MINOR,   /* Resolved from memory, e.g. shared text. */
+    FAULT_MAJOR,   /* Read the page from a file or swap. */
+    FAULT_ZERO,    /* Gave the page zeros, or the zero frame. */
+    FAULT_COW,     /* Copied or upgraded a copy-on-write page. */
+    FAULT_STACK,   /* Grew the stack. */
+    FAULT_INVALID, /* Bad access; the process dies. */
+    FAULT_CLASS_CNT
+};
+
+/* Latency histograms have a bucket per power of two of CPU cycles.
+   Bucket 0 counts faults that took less than
+   2**(FAULT_HIST_SHIFT + 1) cycles, bucket I those that took from
+   2**(FAULT_HIST_SHIFT + I) cycles up to twice that, and the last
+   bucket everything longer. */
+#define FAULT_HIST_BUCKETS 16
+#define FAULT_HIST_SHIFT 10
+
+/* Faults of one class.  The time a fault spends waiting for the
+   disk counts as I/O, the rest as CPU. */
+struct fault_class_stat {
+    uint64_t cnt;                          /* Number of faults. */
+    uint64_t cpu_cycles;                   /* Total CPU cycles. */
+    uint64_t io_cycles;                    /* Total I/O wait cycles. */
+    uint32_t cpu_hist[FAULT_HIST_BUCKETS]; /* CPU cycles per fault. */
+    uint32_t io_hist[FAULT_HIST_BUCKETS];  /* I/O wait cycles per fault. */
+};
+
+/* Page-fault statistics of a process or of the whole system. */
+struct fault_stat {
+    struct fault_class_stat classes[FAULT_CLASS_CNT];
+    uint64_t filesys_locked_cnt; /* Faults taken while holding the file system lock. */
+};
+
+#endif /* lib/fault-stat.h */
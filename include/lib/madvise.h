@@ -0,0 +1,13 @@
+#ifndef __LIB_MADVISE_H
+#define __LIB_MADVISE_H
+
+/* Advice for madvise() about how a range of memory will be used. */
+enum madvise_advice {
+    MADV_NORMAL,     /* No special treatment. */
+    MADV_RANDOM,     /* Random access: do not fault around. */
+    MADV_SEQUENTIAL, /* Front to back: read far ahead, evict behind. */
+    MADV_WILLNEED,   /* Will be used soon: load it now. */
+    MADV_DONTNEED,   /* Not needed: drop it now. */
+};
+
+#endif /* lib/madvise.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_MEM_STAT_H
+#define __LIB_MEM_STAT_H
+
+#include <stddef.h>
+
+/* Memory use of a process, as memstat() reports it.  Sizes are in
+   pages. */
+struct mem_stat {
+    size_t rss;       /* Pages in frames; shared ones count for each sharer. */
+    size_t rss_peak;  /* Largest RSS so far. */
+    size_t rss_limit; /* Most pages the process may hold, or 0 for no limit. */
+    size_t ws_size;   /* Pages used in the last sampling interval, or 0. */
+    size_t evict_cnt; /* Own pages evicted to stay within quota. */
+};
+
+#endif /* lib/mem-stat.h */
@@ -36,6 +36,13 @@ enum {
 
     SYS_MOUNT,
     SYS_UMOUNT,
+
+    /* Extra for Project 3 */
+    SYS_MSYNC,     /* Write a memory mapping back to its file. */
+    SYS_FAULTSTAT, /* Obtain page-fault statistics. */
+    SYS_MADVISE,   /* Give advice about memory use. */
+    SYS_RSSLIMIT,  /* Limit the process's resident set. */
+    SYS_MEMSTAT,   /* Obtain the process's memory use. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <fault-stat.h>
+#include <madvise.h>
+#include <mem-stat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -41,6 +44,11 @@ int dup2(int oldfd, int newfd);
 /* Project 3 and optionally project 4. */
 void* mmap(void* addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void* addr);
+int msync(void* addr, size_t length);
+int faultstat(struct fault_stat* stat, bool system);
+int madvise(void* addr, size_t length, int advice);
+int rsslimit(size_t pages);
+int memstat(struct mem_stat* stat);
 
 /* Project 4 only. */
 bool chdir(const char* dir);
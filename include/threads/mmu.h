@@ -2,6 +2,7 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
@@ -12,9 +13,14 @@ uint64_t* pml4_create(void);
 bool pml4_for_each(uint64_t*, pte_for_each_func*, void*);
 void pml4_destroy(uint64_t* pml4);
 void pml4_activate(uint64_t* pml4);
+void pml4_print_stats(void);
 void* pml4_get_page(uint64_t* pml4, const void* upage);
 bool pml4_set_page(uint64_t* pml4, void* upage, void* kpage, bool rw);
 void pml4_clear_page(uint64_t* pml4, void* upage);
+bool pml4_map_range(uint64_t* pml4, void* upage, void* const kpages[], size_t page_cnt, bool rw);
+void pml4_unmap_range(uint64_t* pml4, void* upage, size_t page_cnt);
+void pml4_protect_range(uint64_t* pml4, void* upage, size_t page_cnt, bool rw);
+bool pml4_copy_range(uint64_t* dst, uint64_t* src, void* upage, size_t page_cnt);
 bool pml4_is_dirty(uint64_t* pml4, const void* upage);
 void pml4_set_dirty(uint64_t* pml4, const void* upage, bool dirty);
 bool pml4_is_accessed(uint64_t* pml4, const void* upage);
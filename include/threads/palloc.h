@@ -11,6 +11,11 @@ enum palloc_flags {
     PAL_USER = 004    /* User page. */
 };
 
+/* Called with a chunk of PAGE_CNT pages starting at PAGES that
+   another pool wants; should release as many of them as it can
+   and return the number released. */
+typedef size_t palloc_reclaim_func(void* pages, size_t page_cnt);
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
@@ -19,7 +24,12 @@ void* palloc_get_page(enum palloc_flags);
 void* palloc_get_multiple(enum palloc_flags, size_t page_cnt);
 void palloc_free_page(void*);
 void palloc_free_multiple(void*, size_t page_cnt);
+size_t palloc_pool_pages(enum palloc_flags);
+size_t palloc_free_pages(enum palloc_flags);
+void palloc_set_reclaim(enum palloc_flags, palloc_reclaim_func*);
+void palloc_print_stats(void);
 
 #endif /* threads/palloc.h */
 
-size_t user_pool_pages(void);
\ No newline at end of file
+size_t user_pool_pages(void);
+void* user_pool_base(void);
\ No newline at end of file
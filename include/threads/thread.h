@@ -123,6 +123,10 @@ struct thread {
 
     int64_t wakeup_tick;
 
+    /* Owned by devices/disk.c. */
+    uint64_t disk_cycles;   /* Cycles spent in disk_read() and disk_write(). */
+    uint64_t disk_read_cnt; /* Sectors read by this thread. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint64_t* pml4;                     /* Page map level 4 */
@@ -135,6 +139,9 @@ struct thread {
 #ifdef VM
     /* Table for whole virtual memory owned by thread. */
     struct supplemental_page_table spt;
+    uint8_t* user_rsp;             /* User rsp on system call entry, for stack growth. */
+    struct fault_stat* fault_stat; /* Page-fault statistics, or null. */
+    struct rss rss;                /* Resident set and its limit. */
 #endif
 
     /* Owned by thread.c. */
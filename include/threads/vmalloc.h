@@ -0,0 +1,26 @@
+#ifndef THREADS_VMALLOC_H
+#define THREADS_VMALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Kernel virtual window that vmalloc() maps its pages into.
+ * It lives in the kernel half of the address space (PML4 slot 1,
+ * which every pml4 shares with base_pml4), well above the direct
+ * mapping of physical memory. */
+#define VMALLOC_START 0x9000000000
+#define VMALLOC_PAGES (PGSIZE * 8) /* One bitmap page worth: 128 MB. */
+#define VMALLOC_END (VMALLOC_START + (uint64_t)VMALLOC_PAGES * PGSIZE)
+
+/* Returns true if VADDR lies inside the vmalloc() window. */
+#define is_vmalloc_vaddr(vaddr) ((uint64_t)(vaddr) >= VMALLOC_START && (uint64_t)(vaddr) < VMALLOC_END)
+
+void vmalloc_init(void);
+void* vmalloc(enum palloc_flags, size_t page_cnt);
+void vfree(void* pages, size_t page_cnt);
+void vmalloc_print_stats(void);
+
+#endif /* threads/vmalloc.h */
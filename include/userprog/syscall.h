@@ -7,5 +7,7 @@ void syscall_init(void);
 void exit(int status);
 
 extern struct lock filesys_lock; /* 파일 시스템 전역 락 */
+bool filesys_enter(void);
+void filesys_leave(bool held);
 
 #endif /* userprog/syscall.h */
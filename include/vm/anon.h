@@ -1,12 +1,19 @@
 #ifndef VM_ANON_H
 #define VM_ANON_H
+#include <stddef.h>
 #include "vm/vm.h"
 struct page;
 enum vm_type;
 
-struct anon_page {};
+struct anon_page {
+    size_t slot; /* Swap slot holding the page, or BITMAP_ERROR. */
+};
 
 void vm_anon_init(void);
 bool anon_initializer(struct page* page, enum vm_type type, void* kva);
+void anon_read_swapped(struct page* page, void* kva);
+bool anon_swap_out_cluster(struct page* pages[], size_t cnt);
+void anon_swap_dup(struct page* dst, struct page* src);
+void swap_print_stats(void);
 
 #endif
@@ -0,0 +1,14 @@
+#ifndef VM_FAULT_H
+#define VM_FAULT_H
+#include <fault-stat.h>
+#include <stdbool.h>
+
+struct thread;
+
+void fault_stat_init(struct thread*);
+void fault_stat_exit(struct thread*);
+void fault_account(enum fault_class, uint64_t cycles, uint64_t io_cycles, bool filesys_locked);
+bool fault_stat_get(struct fault_stat* dst, bool system);
+void fault_print_stats(void);
+
+#endif /* vm/fault.h */
@@ -6,10 +6,16 @@
 struct page;
 enum vm_type;
 
-struct file_page {};
+struct file_page {
+    struct file* file;  /* Region's file; owned by the region. */
+    off_t offset;       /* File offset of the page. */
+    size_t read_bytes;  /* Bytes of the page backed by FILE. */
+};
 
 void vm_file_init(void);
 bool file_backed_initializer(struct page* page, enum vm_type type, void* kva);
 void* do_mmap(void* addr, size_t length, int writable, struct file* file, off_t offset);
 void do_munmap(void* va);
+int do_msync(void* addr, size_t length);
+void file_page_flush(struct page* page);
 #endif
@@ -0,0 +1,14 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stddef.h>
+
+struct frame;
+
+void ksm_set_rate(size_t);
+void ksm_init(void);
+struct frame* ksm_lookup(unsigned sum);
+void ksm_insert(struct frame*);
+void ksm_remove(struct frame*);
+void ksm_print_stats(void);
+
+#endif /* vm/ksm.h */
@@ -0,0 +1,12 @@
+#ifndef VM_KSWAPD_H
+#define VM_KSWAPD_H
+#include <stdbool.h>
+#include <stddef.h>
+
+bool kswapd_set_watermarks(size_t low, size_t high);
+void kswapd_init(void);
+void kswapd_poke(bool direct);
+bool kswapd_below_low(void);
+void kswapd_print_stats(void);
+
+#endif /* vm/kswapd.h */
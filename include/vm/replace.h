@@ -0,0 +1,25 @@
+#ifndef VM_REPLACE_H
+#define VM_REPLACE_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct frame;
+struct page;
+
+/* Lists a frame can be on, in struct frame's LRU_LIST. */
+enum lru_list { LRU_NONE, LRU_CLOCK, LRU_A1IN, LRU_AM, LRU_T1, LRU_T2, LRU_CNT };
+
+/* History lists a page can be on, in struct page's GHOST. */
+enum ghost_list { GHOST_NONE, GHOST_A1OUT, GHOST_B1, GHOST_B2, GHOST_CNT };
+
+bool replace_select(const char* name);
+void replace_init(size_t frame_cnt);
+void replace_add(struct frame*);
+void replace_remove(struct frame*, bool evicted);
+void replace_skip(struct frame*);
+void replace_deactivate(struct frame*);
+struct frame* replace_victim(void);
+void replace_forget(struct page*);
+void replace_print_stats(void);
+
+#endif /* vm/replace.h */
@@ -0,0 +1,31 @@
+#ifndef VM_RSS_H
+#define VM_RSS_H
+#include <mem-stat.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Resident set of a process, see vm/rss.c. */
+struct rss {
+    size_t pages;       /* Pages in frames. */
+    size_t peak;        /* Largest PAGES so far. */
+    size_t limit;       /* Quota on PAGES, or 0 for none. */
+    size_t ws_size;     /* Working-set estimate. */
+    int64_t ws_sampled; /* Timer tick of the estimate. */
+    void* hand;         /* Where the search for an own victim resumes. */
+    size_t evict_cnt;   /* Own pages evicted to stay within quota. */
+};
+
+void rss_set_ws_interval(int64_t ticks);
+void rss_fork(struct thread* child, const struct thread* parent);
+void rss_charge(struct thread*, int delta);
+void rss_evicted(struct thread*);
+bool rss_over_quota(struct thread*);
+void rss_sample(struct thread*);
+int rss_set_limit(size_t pages);
+void rss_stat_get(struct mem_stat*);
+void rss_print_stats(void);
+
+#endif /* vm/rss.h */
@@ -0,0 +1,35 @@
+#ifndef VM_SPT_H
+#define VM_SPT_H
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct page;
+struct vm_area;
+
+/* Supplemental page table: a radix tree keyed by virtual page
+ * number, with the same four 9-bit levels as the pml4.  Nodes
+ * exist only along paths to mapped pages, and are freed again
+ * when they empty out. */
+struct supplemental_page_table {
+    void** root;               /* Top-level node, or null while empty. */
+    size_t page_cnt;           /* Number of pages in the table. */
+    int walkers;               /* spt_for_each() calls in progress. */
+    void** hint;               /* Leaf used by the last lookup, or null. */
+    uint64_t hint_base;        /* First address covered by HINT. */
+    struct list areas;         /* struct vm_area, sorted by address. */
+    struct vm_area* area_hint; /* Last region found, or null. */
+};
+
+/* Called for each page by spt_for_each().  Returns false to stop
+ * the iteration. */
+typedef bool spt_action_func(struct page*, void* aux);
+
+void spt_init(struct supplemental_page_table*);
+struct page* spt_lookup(struct supplemental_page_table*, const void* va);
+bool spt_insert(struct supplemental_page_table*, struct page*);
+struct page* spt_delete(struct supplemental_page_table*, const void* va);
+bool spt_for_each(struct supplemental_page_table*, const void* start, const void* end, spt_action_func*, void* aux);
+
+#endif /* vm/spt.h */
@@ -0,0 +1,15 @@
+#ifndef VM_TEXT_H
+#define VM_TEXT_H
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct frame;
+struct inode;
+
+void text_init(void);
+struct frame* text_lookup(struct inode*, off_t offset);
+void text_insert(struct frame*, struct inode*, off_t offset);
+void text_remove(struct frame*);
+void text_print_stats(void);
+
+#endif /* vm/text.h */
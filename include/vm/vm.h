@@ -1,9 +1,10 @@
 #ifndef VM_VM_H
 #define VM_VM_H
+#include <hash.h>
 #include <stdbool.h>
 #include "threads/palloc.h"
 #include "list.h"
-#include <hash.h>
+#include "vm/spt.h"
 
 enum vm_type {
     /* page not initialized */
@@ -29,6 +30,12 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/vma.h"
+#include "vm/text.h"
+#include "vm/fault.h"
+#include "vm/replace.h"
+#include "vm/ksm.h"
+#include "vm/rss.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -38,12 +45,6 @@ struct thread;
 
 #define VM_TYPE(type) ((type) & 7)
 
-struct load_aux {
-    off_t ofs;
-    uint32_t read_bytes;
-    uint32_t zero_bytes;
-};
-
 /* The representation of "page".
  * This is kind of "parent class", which has four "child class"es, which are
  * uninit_page, file_page, anon_page, and page cache (project4).
@@ -52,11 +53,14 @@ struct page {
     const struct page_operations* operations;
     void* va;              /* Address in terms of user space */
     struct frame* frame;   /* Back reference for frame */
-    struct hash_elem elem; // SPT entry
     bool writable;         // page구조체에 상태,타입,...등
     enum vm_type type;
 
     /* Your implementation */
+    struct thread* owner;        /* Process whose pml4 maps VA. */
+    struct page* rmap_next;      /* Next page that shares FRAME, or null. */
+    struct list_elem ghost_elem; /* In a replacement history list. */
+    uint8_t ghost;               /* History list the page is on. */
 
     /* Per-type data are binded into the union.
      * Each function automatically detects the current union */
@@ -70,10 +74,39 @@ struct page {
     };
 };
 
-/* The representation of "frame" */
+/* The representation of "frame".  After fork, one frame can back
+ * the same anonymous page in several processes (copy-on-write);
+ * all of them are mapped read-only until the frame is theirs
+ * alone.  Text is shared the same way.
+ *
+ * The frame's reverse map lists every page that maps it: the first
+ * one is kept in RMAP, and any others are chained behind it through
+ * their RMAP_NEXT.  An unshared frame, the usual case, costs one
+ * pointer. */
 struct frame {
     void* kva;
-    struct page* page;
+    struct page* rmap; /* First page that uses the frame, or null. */
+    size_t ref_cnt;    /* Number of pages in the reverse map. */
+    bool pinned;       /* Not to be evicted, e.g. while being filled. */
+    unsigned pin_cnt;  /* Pins by vm_pin_range(), which keep PINNED set. */
+
+    /* Free frames list, while the frame is not in use. */
+    struct list_elem free_elem;
+
+    /* Replacement policy, see vm/replace.c. */
+    struct list_elem lru_elem;
+    uint8_t lru_list; /* List LRU_ELEM is on. */
+    bool lru_fresh;   /* Accessed bits not sampled since loading. */
+
+    /* Shared executable text, see vm/text.c. */
+    struct hash_elem text_elem;
+    struct inode* text_inode; /* File the frame caches, or null. */
+    off_t text_offset;        /* Offset of the page in TEXT_INODE. */
+
+    /* Samepage merging, see vm/ksm.c. */
+    struct hash_elem ksm_elem;
+    unsigned ksm_sum; /* Checksum of the contents at the last scan. */
+    bool ksm_listed;  /* In the table of merge candidates. */
 };
 
 /* The function table for page operations.
@@ -93,17 +126,23 @@ struct page_operations {
     if ((page)->operations->destroy)                                                                                   \
     (page)->operations->destroy(page)
 
-/* Representation of current process's memory space.
- * We don't want to force you to obey any specific design for this struct.
- * All designs up to you for this. */
-struct supplemental_page_table {
-    struct hash pages;
-};
+/* Representation of current process's memory space: see vm/spt.h. */
 
 #include "threads/thread.h"
 void supplemental_page_table_init(struct supplemental_page_table* spt);
 bool supplemental_page_table_copy(struct supplemental_page_table* dst, struct supplemental_page_table* src);
 void supplemental_page_table_kill(struct supplemental_page_table* spt);
+void vm_flush_range(struct supplemental_page_table* spt, void* start, void* end);
+void vm_remove_range(struct supplemental_page_table* spt, void* start, void* end);
+size_t vm_flush_frames(void);
+size_t vm_reclaim_frames(size_t target);
+size_t vm_free_frame_cnt(void);
+size_t vm_ksm_scan(size_t cnt, size_t* merged);
+int do_madvise(void* addr, size_t length, int advice);
+size_t vm_sample_accessed(struct supplemental_page_table* spt);
+size_t vm_trim_rss(size_t target);
+bool vm_pin_range(const void* uaddr, size_t size, bool write);
+void vm_unpin_range(const void* uaddr, size_t size);
 struct page* spt_find_page(struct supplemental_page_table* spt, void* va);
 bool spt_insert_page(struct supplemental_page_table* spt, struct page* page);
 void spt_remove_page(struct supplemental_page_table* spt, struct page* page);
@@ -118,6 +157,7 @@ bool vm_claim_page(void* va);
 enum vm_type page_get_type(struct page* page);
 static bool uninit_initialize(struct page* page, void* kva);
 
-void cleanup_frame_table();
+void cleanup_frame_table(void);
+bool frame_accessed(struct frame* frame, bool clear);
 
 #endif /* VM_VM_H */
@@ -0,0 +1,61 @@
+#ifndef VM_VMA_H
+#define VM_VMA_H
+#include <list.h>
+#include <madvise.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "vm/vm.h"
+
+struct file;
+struct page;
+struct supplemental_page_table;
+
+/* Largest size the user stack may grow to. */
+#define STACK_MAX (1 << 20)
+
+/* Fault-around window, in pages, counting the faulting page. */
+#define FAULT_AROUND_MIN 1
+#define FAULT_AROUND_INIT 4
+#define FAULT_AROUND_MAX 16
+#define FAULT_AROUND_SEQ 32 /* For MADV_SEQUENTIAL regions. */
+
+/* What a region was created for. */
+enum vma_kind {
+    VMA_SEGMENT, /* Part of the executable. */
+    VMA_STACK,   /* User stack; grows down on demand. */
+    VMA_MMAP,    /* mmap()ed file. */
+};
+
+/* A virtual memory region: a page-aligned range of a process's
+ * address space whose pages share a backing and permissions.
+ * Regions are what exec, the stack and mmap create; the struct
+ * page for an address in one is only made when it first
+ * faults. */
+struct vm_area {
+    struct list_elem elem;      /* In supplemental_page_table's AREAS. */
+    uint8_t* start;             /* First page. */
+    uint8_t* end;               /* One past the last page. */
+    struct file* file;          /* Backing file (owned), or null. */
+    off_t offset;               /* File offset of START. */
+    size_t read_bytes;          /* Bytes from START read from FILE. */
+    bool writable;              /* Pages are writable by the user. */
+    enum vm_type type;          /* Type of the pages it materializes. */
+    enum vma_kind kind;
+    uint8_t* around_next;       /* Page after the last fault-around window. */
+    size_t around_pages;        /* Current fault-around window, in pages. */
+    enum madvise_advice advice; /* Access pattern given by madvise(). */
+};
+
+void vma_init(struct supplemental_page_table*);
+struct vm_area* vma_create(struct supplemental_page_table*, void* start, size_t length, enum vma_kind, enum vm_type,
+                           bool writable);
+bool vma_set_file(struct vm_area*, struct file*, off_t offset, size_t read_bytes);
+struct vm_area* vma_find(struct supplemental_page_table*, const void* va);
+struct page* vma_materialize(struct vm_area*, void* va);
+bool vma_grow_stack(struct supplemental_page_table*, void* va);
+void vma_destroy(struct supplemental_page_table*, struct vm_area*);
+void vma_destroy_all(struct supplemental_page_table*);
+bool vma_copy_all(struct supplemental_page_table* dst, struct supplemental_page_table* src);
+
+#endif /* vm/vma.h */
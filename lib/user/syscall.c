@@ -135,6 +135,31 @@ void munmap(void* addr)
     syscall1(SYS_MUNMAP, addr);
 }
 
+int msync(void* addr, size_t length)
+{
+    return syscall2(SYS_MSYNC, addr, length);
+}
+
+int faultstat(struct fault_stat* stat, bool system)
+{
+    return syscall2(SYS_FAULTSTAT, stat, system);
+}
+
+int madvise(void* addr, size_t length, int advice)
+{
+    return syscall3(SYS_MADVISE, addr, length, advice);
+}
+
+int rsslimit(size_t pages)
+{
+    return syscall1(SYS_RSSLIMIT, pages);
+}
+
+int memstat(struct mem_stat* stat)
+{
+    return syscall1(SYS_MEMSTAT, stat);
+}
+
 bool chdir(const char* dir)
 {
     return syscall1(SYS_CHDIR, dir);
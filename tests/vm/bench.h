@@ -0,0 +1,19 @@
+#ifndef TESTS_VM_BENCH_H
+#define TESTS_VM_BENCH_H
+
+#include <stdint.h>
+
+/* Helpers for the VM microbenchmarks.  Timings under an emulator
+   depend on the load of the host, so the benchmarks only print
+   what they measure, for a person to compare; they never pass or
+   fail on timings. */
+
+/* Returns the CPU time-stamp counter. */
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif /* tests/vm/bench.h */
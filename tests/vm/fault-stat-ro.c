@@ -0,0 +1,13 @@
+/* Passes a pointer into the code segment to faultstat(), which
+   must not write the statistics there.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void test_main(void)
+{
+    faultstat((struct fault_stat*)test_main, false);
+    fail("faultstat() wrote into the code segment");
+}
@@ -0,0 +1,22 @@
+/* Passes faultstat() a buffer that starts on the last bytes of a
+   mapped page and runs onto the unmapped page after it.  Only the
+   first byte is valid, so the kernel must check the whole buffer
+   before copying the statistics out.
+   The process must be terminated with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+void test_main(void)
+{
+    char* map = (char*)0x10000000;
+    int handle;
+
+    CHECK((handle = open("sample.txt")) > 1, "open \"sample.txt\"");
+    CHECK(mmap(map, PAGE_SIZE, 1, handle, 0) != MAP_FAILED, "mmap \"sample.txt\"");
+    faultstat((struct fault_stat*)(map + PAGE_SIZE - 16), false);
+    fail("faultstat() wrote past the end of the mapping");
+}
@@ -0,0 +1,32 @@
+/* Checks the page-fault statistics: touching fresh pages of the
+   BSS must show up as zero-fill faults of this process, and the
+   system-wide numbers must include the process's own. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 32
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void test_main(void)
+{
+    struct fault_stat before, after, system;
+    size_t i;
+
+    CHECK(faultstat(&before, false) == 0, "get process statistics");
+    for (i = 0; i < PAGE_CNT; i++)
+        buf[i * PAGE_SIZE] = 1;
+    CHECK(faultstat(&after, false) == 0, "get process statistics again");
+    CHECK(faultstat(&system, true) == 0, "get system statistics");
+
+    /* The first page of BUF may share a page with initialized data. */
+    CHECK(after.classes[FAULT_ZERO].cnt - before.classes[FAULT_ZERO].cnt >= PAGE_CNT - 1,
+          "touching %d pages counts as zero-fill faults", PAGE_CNT);
+    for (i = 0; i < FAULT_CLASS_CNT; i++)
+        if (system.classes[i].cnt < after.classes[i].cnt)
+            fail("class %zu: system count below process count", i);
+    msg("system counts include the process");
+}
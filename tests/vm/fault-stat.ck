@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fault-stat) begin
+(fault-stat) get process statistics
+(fault-stat) get process statistics again
+(fault-stat) get system statistics
+(fault-stat) touching 32 pages counts as zero-fill faults
+(fault-stat) system counts include the process
+(fault-stat) end
+EOF
+pass;
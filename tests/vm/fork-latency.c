@@ -0,0 +1,58 @@
+/* Fork microbenchmark: makes a growing part of a large buffer
+   resident and reports how long fork() takes for each size.  With
+   copy-on-write the child shares the parent's frames instead of
+   copying them, so fork should not get much slower as the parent
+   grows. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 512
+#define ROUNDS 4
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+static const size_t sizes[] = {1, 16, 128, PAGE_CNT};
+
+#define SIZE_CNT (sizeof sizes / sizeof *sizes)
+
+/* Returns the fastest of ROUNDS forks, in cycles. */
+static uint64_t time_fork(void)
+{
+    uint64_t best = UINT64_MAX;
+    int r;
+
+    for (r = 0; r < ROUNDS; r++) {
+        uint64_t start = rdtsc();
+        pid_t pid = fork("child");
+        uint64_t cycles = rdtsc() - start;
+
+        if (pid == 0)
+            exit(0);
+        if (pid < 0)
+            fail("fork failed");
+        wait(pid);
+        if (cycles < best)
+            best = cycles;
+    }
+    return best;
+}
+
+void test_main(void)
+{
+    uint64_t cycles[SIZE_CNT];
+    size_t s, i, touched = 0;
+
+    for (s = 0; s < SIZE_CNT; s++) {
+        for (i = touched; i < sizes[s]; i++)
+            buf[i * PAGE_SIZE] = 1;
+        touched = sizes[s];
+        cycles[s] = time_fork();
+    }
+
+    for (s = 0; s < SIZE_CNT; s++)
+        msg("%4zu pages: %llu cycles/fork", sizes[s], (unsigned long long)cycles[s]);
+}
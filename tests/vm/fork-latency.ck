@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing per-size fork costs"
+  unless grep (/^\(fork-latency\) +\d+ pages: \d+ cycles\/fork$/, @output) == 4;
+fail "missing end of test"
+  unless grep ($_ eq '(fork-latency) end', @output);
+
+pass;
@@ -0,0 +1,114 @@
+/* Fills pages with the same contents, zero pages and pages of
+   their own, and waits for the ksm thread, which the test boots
+   with -ksm=4000, to merge them.  The ksm thread only runs while
+   the CPU is idle, so the test waits by reading a file.  A merged
+   page is read-only, so rewriting one of the identical pages takes
+   a copy-on-write fault once the merge has happened.  Then checks
+   that writes to merged pages stay private. */
+
+#include <fault-stat.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define SAME_PAGES 64
+#define ZERO_PAGES 32
+#define UNIQUE_PAGES 32
+#define MAX_ROUNDS 500
+
+static uint8_t same[SAME_PAGES][PAGE_SIZE];
+static uint8_t zero[ZERO_PAGES][PAGE_SIZE];
+static uint8_t unique[UNIQUE_PAGES][PAGE_SIZE];
+static uint8_t io_buf[4 * PAGE_SIZE];
+
+/* Returns this process's copy-on-write faults so far. */
+static uint64_t cow_faults(void)
+{
+    struct fault_stat stat;
+
+    if (faultstat(&stat, false) != 0)
+        fail("faultstat failed");
+    return stat.classes[FAULT_COW].cnt;
+}
+
+static uint8_t same_byte(size_t ofs)
+{
+    return ofs * 7 + 1;
+}
+
+static uint8_t unique_byte(size_t page, size_t ofs)
+{
+    return page * 31 + ofs * 13;
+}
+
+/* Checks every page, with the first byte of identical page I
+   expected to be FIRST[I]. */
+static void check_all(const uint8_t first[SAME_PAGES])
+{
+    size_t i, ofs;
+
+    for (i = 0; i < SAME_PAGES; i++)
+        for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+            if (same[i][ofs] != (ofs == 0 ? first[i] : same_byte(ofs)))
+                fail("identical page %zu, byte %zu is wrong", i, ofs);
+    for (i = 0; i < ZERO_PAGES; i++)
+        for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+            if (zero[i][ofs] != 0)
+                fail("zero page %zu, byte %zu is wrong", i, ofs);
+    for (i = 0; i < UNIQUE_PAGES; i++)
+        for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+            if (unique[i][ofs] != unique_byte(i, ofs))
+                fail("unique page %zu, byte %zu is wrong", i, ofs);
+}
+
+void test_main(void)
+{
+    uint8_t first[SAME_PAGES];
+    size_t i, ofs, round;
+    int fd;
+
+    msg("fill");
+    for (i = 0; i < SAME_PAGES; i++) {
+        for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+            same[i][ofs] = same_byte(ofs);
+        first[i] = same_byte(0);
+    }
+    for (i = 0; i < ZERO_PAGES; i++) {
+        zero[i][0] = 1;
+        zero[i][0] = 0;
+    }
+    for (i = 0; i < UNIQUE_PAGES; i++)
+        for (ofs = 0; ofs < PAGE_SIZE; ofs++)
+            unique[i][ofs] = unique_byte(i, ofs);
+
+    msg("wait for merge");
+    CHECK((fd = open("large.txt")) > 1, "open \"large.txt\"");
+    for (round = 0; round < MAX_ROUNDS; round++) {
+        volatile uint8_t* probe = &same[round % SAME_PAGES][0];
+        uint64_t before;
+
+        if (read(fd, io_buf, sizeof io_buf) < (int)sizeof io_buf)
+            seek(fd, 0);
+        before = cow_faults();
+        *probe = *probe;
+        if (cow_faults() != before)
+            break;
+    }
+    close(fd);
+    if (round == MAX_ROUNDS)
+        fail("identical pages were never merged");
+    msg("merged");
+
+    msg("check");
+    check_all(first);
+
+    msg("write");
+    for (i = 0; i < SAME_PAGES; i++)
+        same[i][0] = first[i] = i;
+
+    msg("check again");
+    check_all(first);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my ($stats) = grep (/^KSM: /, @output);
+fail "missing samepage merging statistics" unless defined $stats;
+fail "no pages merged: $stats"
+  unless $stats =~ /(\d+) merged/ && $1 > 0;
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(ksm) begin
+(ksm) fill
+(ksm) wait for merge
+(ksm) open "large.txt"
+(ksm) merged
+(ksm) check
+(ksm) write
+(ksm) check again
+(ksm) end
+EOF
+pass;
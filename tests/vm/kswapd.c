@@ -0,0 +1,29 @@
+/* Writes and then checks twice as many pages as the kernel lets
+   the process keep resident.  The test boots with -ul=256 and
+   -wm=32,64, so the page-out daemon has to keep frames free while
+   it runs; the checker looks for its statistics line. */
+
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 512
+
+static uint8_t buf[PAGES * PAGE_SIZE];
+
+void test_main(void)
+{
+    size_t i, round;
+
+    msg("write");
+    for (i = 0; i < PAGES; i++)
+        buf[i * PAGE_SIZE] = i % 251;
+
+    for (round = 0; round < 2; round++) {
+        msg("check, round %zu", round);
+        for (i = 0; i < PAGES; i++)
+            if (buf[i * PAGE_SIZE] != i % 251)
+                fail("page %zu holds %d, not %zu", i, buf[i * PAGE_SIZE], i % 251);
+    }
+}
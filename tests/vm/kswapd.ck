@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my ($stats) = grep (/^Kswapd: /, @output);
+fail "missing page-out daemon statistics" unless defined $stats;
+fail "watermarks not taken from -wm: $stats"
+  unless $stats =~ /watermarks 32\/64 pages/;
+fail "page-out daemon never woke: $stats"
+  unless $stats =~ /, (\d+) wakeups/ && $1 > 0;
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(kswapd) begin
+(kswapd) write
+(kswapd) check, round 0
+(kswapd) check, round 1
+(kswapd) end
+EOF
+pass;
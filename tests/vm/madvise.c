@@ -0,0 +1,89 @@
+/* Exercises each kind of madvise() advice on a mapping of
+   "large.txt" and on anonymous memory.  Prefetched pages must not
+   fault again, sequential advice must read the mapping in a few
+   large windows, random advice must fault in every page on its
+   own, and dropped pages must come back with their original
+   contents: the file's for the mapping, zeros for the BSS. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define MAP_PAGES 64
+#define ANON_PAGES 4
+
+static char bss[(ANON_PAGES + 1) * PAGE_SIZE];
+static char expect[PAGE_SIZE];
+
+/* Returns the number of major faults the process has taken. */
+static uint64_t major_faults(void)
+{
+    struct fault_stat stat;
+
+    if (faultstat(&stat, false) != 0)
+        fail("faultstat failed");
+    return stat.classes[FAULT_MAJOR].cnt;
+}
+
+/* Reads every page of MAP and compares it against the file HANDLE.
+   Returns the number of major faults taken meanwhile. */
+static uint64_t check_map(int handle, const char* map)
+{
+    uint64_t before = major_faults();
+    size_t i;
+
+    for (i = 0; i < MAP_PAGES; i++) {
+        volatile char c = map[i * PAGE_SIZE];
+        (void)c;
+    }
+    before = major_faults() - before;
+
+    for (i = 0; i < MAP_PAGES; i++) {
+        seek(handle, i * PAGE_SIZE);
+        if (read(handle, expect, PAGE_SIZE) != PAGE_SIZE)
+            fail("read of page %zu of \"large.txt\" failed", i);
+        if (memcmp(map + i * PAGE_SIZE, expect, PAGE_SIZE))
+            fail("page %zu of the mapping differs from the file", i);
+    }
+    return before;
+}
+
+void test_main(void)
+{
+    char* map = (char*)0x10000000;
+    char* anon = (char*)(((uintptr_t)bss + PAGE_SIZE - 1) & ~(uintptr_t)(PAGE_SIZE - 1));
+    size_t length = MAP_PAGES * PAGE_SIZE;
+    int handle;
+    size_t i;
+
+    CHECK((handle = open("large.txt")) > 1, "open \"large.txt\"");
+    CHECK(mmap(map, length, 0, handle, 0) != MAP_FAILED, "mmap \"large.txt\"");
+
+    CHECK(madvise(map + 1, PAGE_SIZE, MADV_NORMAL) == -1, "unaligned address is rejected");
+    CHECK(madvise(map, PAGE_SIZE, MADV_DONTNEED + 1) == -1, "unknown advice is rejected");
+    CHECK(madvise(map + length, PAGE_SIZE, MADV_NORMAL) == -1, "unmapped range is rejected");
+
+    CHECK(madvise(map, length, MADV_WILLNEED) == 0, "MADV_WILLNEED");
+    CHECK(check_map(handle, map) == 0, "prefetched pages do not fault");
+
+    CHECK(madvise(map, length, MADV_DONTNEED) == 0, "MADV_DONTNEED");
+    CHECK(madvise(map, length, MADV_SEQUENTIAL) == 0, "MADV_SEQUENTIAL");
+    CHECK(check_map(handle, map) <= MAP_PAGES / 16, "sequential read faults once per window");
+
+    CHECK(madvise(map, length, MADV_DONTNEED) == 0, "MADV_DONTNEED");
+    CHECK(madvise(map, length, MADV_RANDOM) == 0, "MADV_RANDOM");
+    CHECK(check_map(handle, map) == MAP_PAGES, "random read faults once per page");
+
+    memset(anon, 0xa5, ANON_PAGES * PAGE_SIZE);
+    CHECK(madvise(anon, ANON_PAGES * PAGE_SIZE, MADV_DONTNEED) == 0, "MADV_DONTNEED on anonymous memory");
+    for (i = 0; i < ANON_PAGES * PAGE_SIZE; i++)
+        if (anon[i] != 0)
+            fail("byte %zu is %02hhx after MADV_DONTNEED (should be 0)", i, anon[i]);
+    msg("dropped anonymous pages read back as zeros");
+
+    munmap(map);
+    close(handle);
+}
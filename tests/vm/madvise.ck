@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise) begin
+(madvise) open "large.txt"
+(madvise) mmap "large.txt"
+(madvise) unaligned address is rejected
+(madvise) unknown advice is rejected
+(madvise) unmapped range is rejected
+(madvise) MADV_WILLNEED
+(madvise) prefetched pages do not fault
+(madvise) MADV_DONTNEED
+(madvise) MADV_SEQUENTIAL
+(madvise) sequential read faults once per window
+(madvise) MADV_DONTNEED
+(madvise) MADV_RANDOM
+(madvise) random read faults once per page
+(madvise) MADV_DONTNEED on anonymous memory
+(madvise) dropped anonymous pages read back as zeros
+(madvise) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Page-fault microbenchmark: touches a large, lazily loaded
+   buffer one page at a time and reports the average cost of a
+   fault for each quarter of it.  The supplemental page table
+   grows as the buffer is touched, so the later quarters would
+   be slower if finding a page depended on how many pages the
+   process already has. */
+
+#include <stdint.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 1024
+#define BUCKET_CNT 4
+#define BUCKET_PAGES (PAGE_CNT / BUCKET_CNT)
+
+static char buf[PAGE_CNT * PAGE_SIZE];
+
+void test_main(void)
+{
+    uint64_t cycles[BUCKET_CNT];
+    size_t b, i;
+
+    for (b = 0; b < BUCKET_CNT; b++) {
+        uint64_t start = rdtsc();
+
+        for (i = 0; i < BUCKET_PAGES; i++)
+            buf[(b * BUCKET_PAGES + i) * PAGE_SIZE] = 1;
+        cycles[b] = (rdtsc() - start) / BUCKET_PAGES;
+    }
+
+    for (b = 0; b < BUCKET_CNT; b++)
+        msg("pages %4zu-%4zu: %llu cycles/fault", b * BUCKET_PAGES, (b + 1) * BUCKET_PAGES - 1,
+            (unsigned long long)cycles[b]);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "missing per-bucket fault costs"
+  unless grep (/^\(pf-lookup\) pages .*: \d+ cycles\/fault$/, @output) == 4;
+fail "missing end of test"
+  unless grep ($_ eq '(pf-lookup) end', @output);
+
+pass;
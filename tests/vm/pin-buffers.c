@@ -0,0 +1,43 @@
+/* Passes buffers that are not in memory to read() and write(): a
+   mapping of "large.txt" whose pages must be read from the file
+   system, and fresh pages of the BSS.  The kernel has to fault
+   them in before it takes the file system lock; the process's
+   fault statistics count any fault taken while holding it. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (96 * 1024)
+
+static char buf[SIZE];
+
+void test_main(void)
+{
+    char* map = (char*)0x10000000;
+    struct fault_stat before, after;
+    int handle, copy;
+
+    CHECK((handle = open("large.txt")) > 1, "open \"large.txt\"");
+    CHECK(mmap(map, SIZE, 0, handle, 0) != MAP_FAILED, "mmap \"large.txt\"");
+    CHECK(create("copy", SIZE), "create \"copy\"");
+    CHECK((copy = open("copy")) > 1, "open \"copy\"");
+    CHECK(faultstat(&before, false) == 0, "get process statistics");
+
+    CHECK(write(copy, map, SIZE) == SIZE, "write mapped pages to \"copy\"");
+    seek(copy, 0);
+    CHECK(read(copy, buf, SIZE) == SIZE, "read \"copy\" into fresh pages");
+    CHECK(faultstat(&after, false) == 0, "get process statistics again");
+    if (after.filesys_locked_cnt != before.filesys_locked_cnt)
+        fail("%llu faults taken under the file system lock",
+             (unsigned long long)(after.filesys_locked_cnt - before.filesys_locked_cnt));
+    msg("no faults under the file system lock");
+    if (memcmp(buf, map, SIZE))
+        fail("\"copy\" differs from \"large.txt\"");
+    msg("contents match");
+
+    close(copy);
+    munmap(map);
+    close(handle);
+}
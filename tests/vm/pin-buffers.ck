@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(pin-buffers) begin
+(pin-buffers) open "large.txt"
+(pin-buffers) mmap "large.txt"
+(pin-buffers) create "copy"
+(pin-buffers) open "copy"
+(pin-buffers) get process statistics
+(pin-buffers) write mapped pages to "copy"
+(pin-buffers) read "copy" into fresh pages
+(pin-buffers) get process statistics again
+(pin-buffers) no faults under the file system lock
+(pin-buffers) contents match
+(pin-buffers) end
+EOF
+pass;
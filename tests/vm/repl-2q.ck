@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $workload ('scan+hot', 'loop', 'random') {
+    fail "missing fault count for $workload"
+      unless grep (/^\(repl-2q\) \Q$workload\E: \d+ major faults$/, @output);
+}
+fail "missing end of test"
+  unless grep ($_ eq '(repl-2q) end', @output);
+
+pass;
@@ -0,0 +1,115 @@
+/* Page replacement benchmark.  Runs three access patterns in more
+   memory than the kernel lets the process keep resident, and
+   reports how many faults each one takes to read a page back from
+   swap.  The same program runs once for each replacement policy,
+   as repl-clock, repl-2q and repl-arc:
+
+     scan+hot  A small hot set used over and over, between reads
+               of a large buffer that is used only once.  A policy
+               that resists scans keeps the hot set resident.
+
+     loop      Sequential passes over slightly more pages than fit.
+               LRU and clock miss on every page.
+
+     random    Uniform accesses over twice the pages that fit. */
+
+#include <random.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+
+/* The tests boot with -ul=256, so at most 256 user frames. */
+#define HOT_PAGES 96
+#define SCAN_PAGES 1024
+#define SCAN_CHUNK 64
+#define LOOP_PAGES 320
+#define LOOP_ROUNDS 4
+#define RANDOM_PAGES 512
+#define RANDOM_TOUCHES 2048
+
+static uint8_t hot[HOT_PAGES * PAGE_SIZE];
+static uint8_t scan[SCAN_PAGES * PAGE_SIZE];
+static uint8_t loop[LOOP_PAGES * PAGE_SIZE];
+static uint8_t rnd[RANDOM_PAGES * PAGE_SIZE];
+
+static volatile uint8_t sink;
+
+/* Returns this process's major faults so far. */
+static uint64_t major_faults(void)
+{
+    struct fault_stat stat;
+
+    if (faultstat(&stat, false) != 0)
+        fail("faultstat failed");
+    return stat.classes[FAULT_MAJOR].cnt;
+}
+
+/* Writes every page of the SIZE bytes at BUF once, so that later
+   misses read from swap. */
+static void populate(uint8_t* buf, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i += PAGE_SIZE)
+        buf[i] = 1;
+}
+
+static void touch(const uint8_t* buf, size_t page)
+{
+    sink = buf[page * PAGE_SIZE];
+}
+
+static void run_scan_hot(void)
+{
+    size_t chunk, i, round;
+
+    for (chunk = 0; chunk < SCAN_PAGES / SCAN_CHUNK; chunk++) {
+        for (round = 0; round < 2; round++)
+            for (i = 0; i < HOT_PAGES; i++)
+                touch(hot, i);
+        for (i = 0; i < SCAN_CHUNK; i++)
+            touch(scan, chunk * SCAN_CHUNK + i);
+    }
+}
+
+static void run_loop(void)
+{
+    size_t round, i;
+
+    for (round = 0; round < LOOP_ROUNDS; round++)
+        for (i = 0; i < LOOP_PAGES; i++)
+            touch(loop, i);
+}
+
+static void run_random(void)
+{
+    size_t i;
+
+    for (i = 0; i < RANDOM_TOUCHES; i++)
+        touch(rnd, random_ulong() % RANDOM_PAGES);
+}
+
+/* Runs WORKLOAD and reports its major faults under NAME. */
+static void measure(const char* name, void (*workload)(void))
+{
+    uint64_t before = major_faults();
+
+    workload();
+    msg("%s: %llu major faults", name, (unsigned long long)(major_faults() - before));
+}
+
+void test_main(void)
+{
+    populate(hot, sizeof hot);
+    populate(scan, sizeof scan);
+    measure("scan+hot", run_scan_hot);
+
+    populate(loop, sizeof loop);
+    measure("loop", run_loop);
+
+    populate(rnd, sizeof rnd);
+    measure("random", run_random);
+}
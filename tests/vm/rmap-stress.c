@@ -0,0 +1,84 @@
+/* Reverse-map stress test: many processes share the frames of one
+   large buffer copy-on-write while memory is too small to hold
+   them, so the evictor must unmap frames from every process that
+   maps them.  Each child reads the whole buffer, writes half of
+   it, and checks that it sees its own writes and the parent's data
+   everywhere else.  The parent then checks that its copy was left
+   alone. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 512
+#define CHILD_CNT 8
+
+static uint8_t buf[PAGE_CNT * PAGE_SIZE];
+
+/* Value that process ID (0 for the parent) expects at both ends
+   of page I. */
+static uint8_t expected(size_t i, int id)
+{
+    uint8_t v = (uint8_t)(i * 7 + 1);
+
+    return id > 0 && i % 2 == (size_t)id % 2 ? (uint8_t)(v ^ id) : v;
+}
+
+/* Returns true if every page of BUF holds what ID expects. */
+static bool verify(int id)
+{
+    size_t i;
+
+    for (i = 0; i < PAGE_CNT; i++) {
+        uint8_t* page = buf + i * PAGE_SIZE;
+
+        if (page[0] != expected(i, id) || page[PAGE_SIZE - 1] != expected(i, id))
+            return false;
+    }
+    return true;
+}
+
+static void child(int id)
+{
+    size_t i;
+
+    if (!verify(0))
+        exit(1);
+    for (i = id % 2; i < PAGE_CNT; i += 2) {
+        buf[i * PAGE_SIZE] = expected(i, id);
+        buf[i * PAGE_SIZE + PAGE_SIZE - 1] = expected(i, id);
+    }
+    exit(verify(id) ? 0 : 2);
+}
+
+void test_main(void)
+{
+    pid_t pids[CHILD_CNT];
+    size_t i;
+    int id;
+
+    for (i = 0; i < PAGE_CNT; i++) {
+        buf[i * PAGE_SIZE] = expected(i, 0);
+        buf[i * PAGE_SIZE + PAGE_SIZE - 1] = expected(i, 0);
+    }
+    msg("filled %d pages", PAGE_CNT);
+
+    for (id = 1; id <= CHILD_CNT; id++) {
+        pids[id - 1] = fork("child");
+        if (pids[id - 1] == 0)
+            child(id);
+        if (pids[id - 1] < 0)
+            fail("fork child %d", id);
+    }
+    for (id = 1; id <= CHILD_CNT; id++) {
+        int status = wait(pids[id - 1]);
+
+        if (status != 0)
+            fail("child %d saw wrong data (status %d)", id, status);
+    }
+    msg("%d children saw their own data", CHILD_CNT);
+
+    CHECK(verify(0), "parent's data is intact");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rmap-stress) begin
+(rmap-stress) filled 512 pages
+(rmap-stress) 8 children saw their own data
+(rmap-stress) parent's data is intact
+(rmap-stress) end
+EOF
+pass;
@@ -0,0 +1,46 @@
+/* Limits the process to a resident set of LIMIT pages, then
+   writes and reads back an array several times that size.  The
+   process must stay within its limit by evicting its own pages,
+   and must still read back what it wrote.  The test boots with
+   -ws=10, so memstat() also reports a working-set estimate. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 128
+#define LIMIT 32
+
+static uint32_t buf[PAGES][PAGE_SIZE / sizeof(uint32_t)];
+
+void test_main(void)
+{
+    struct mem_stat st;
+    size_t i;
+
+    CHECK(memstat(&st) == 0, "memstat");
+    CHECK(st.rss > 0 && st.rss_limit == 0, "process has pages and no limit");
+
+    CHECK(rsslimit(LIMIT) == 0, "rsslimit %d", LIMIT);
+    CHECK(memstat(&st) == 0 && st.rss <= LIMIT, "resident set trimmed to the limit");
+
+    msg("write %d pages", PAGES);
+    for (i = 0; i < PAGES; i++)
+        buf[i][i % (PAGE_SIZE / sizeof(uint32_t))] = i + 1;
+    CHECK(memstat(&st) == 0 && st.rss <= LIMIT, "resident set stays within the limit");
+    CHECK(st.evict_cnt >= PAGES - LIMIT, "process evicted its own pages");
+
+    msg("read back");
+    for (i = 0; i < PAGES; i++)
+        if (buf[i][i % (PAGE_SIZE / sizeof(uint32_t))] != i + 1)
+            fail("page %zu lost its contents", i);
+    CHECK(memstat(&st) == 0 && st.rss <= LIMIT, "resident set still within the limit");
+    CHECK(st.ws_size > 0 && st.ws_size <= st.rss_peak, "working set estimated");
+
+    CHECK(rsslimit(0) == 0, "lift the limit");
+    for (i = 0; i < PAGES; i++)
+        buf[i][0] = i;
+    CHECK(memstat(&st) == 0 && st.rss > LIMIT, "resident set grows past the old limit");
+}
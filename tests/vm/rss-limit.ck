@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(rss-limit) begin
+(rss-limit) memstat
+(rss-limit) process has pages and no limit
+(rss-limit) rsslimit 32
+(rss-limit) resident set trimmed to the limit
+(rss-limit) write 128 pages
+(rss-limit) resident set stays within the limit
+(rss-limit) process evicted its own pages
+(rss-limit) read back
+(rss-limit) resident set still within the limit
+(rss-limit) working set estimated
+(rss-limit) lift the limit
+(rss-limit) resident set grows past the old limit
+(rss-limit) end
+EOF
+pass;
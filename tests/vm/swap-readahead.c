@@ -0,0 +1,33 @@
+/* Fills more anonymous memory than the test boots with, then reads
+   it back front to back, twice.  Pages that went out together come
+   back through swap readahead; the checker looks for hits in its
+   statistics.  The test boots with -ul=128 and without the
+   compressed swap cache, so every page is read from disk. */
+
+#include <stdint.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 384
+
+static uint32_t buf[PAGES][PAGE_SIZE / sizeof(uint32_t)];
+
+void test_main(void)
+{
+    size_t i, j, round;
+
+    msg("write");
+    for (i = 0; i < PAGES; i++)
+        for (j = 0; j < PAGE_SIZE / sizeof(uint32_t); j++)
+            buf[i][j] = i * 0x10001 + j;
+
+    for (round = 0; round < 2; round++) {
+        msg("read back, round %zu", round);
+        for (i = 0; i < PAGES; i++)
+            for (j = 0; j < PAGE_SIZE / sizeof(uint32_t); j++)
+                if (buf[i][j] != i * 0x10001 + j)
+                    fail("page %zu, word %zu is %08x", i, j, buf[i][j]);
+    }
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my ($ra) = grep (/^Swap readahead: /, @output);
+fail "missing swap readahead statistics" unless defined $ra;
+fail "nothing was read ahead: $ra"
+  unless $ra =~ /(\d+) pages read ahead/ && $1 > 0;
+fail "no page read ahead was used: $ra"
+  unless $ra =~ /(\d+) hits/ && $1 > 0;
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(swap-readahead) begin
+(swap-readahead) write
+(swap-readahead) read back, round 0
+(swap-readahead) read back, round 1
+(swap-readahead) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Swaps out pages of four kinds: zero-filled, filled with one
+   repeated word, text that compresses well, and pseudo-random
+   bytes that do not compress at all, then checks them all.  The
+   test boots with -ul=128 and a compressed swap cache of only
+   -zswap=8 pages, so the cache fills up and writes its oldest
+   pages back to disk; the checker looks for its statistics. */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PAGES 384
+
+static uint8_t buf[PAGES * PAGE_SIZE];
+
+/* Fills page I with contents of kind I % 4. */
+static void fill(size_t i, uint8_t* page)
+{
+    size_t ofs;
+
+    switch (i % 4) {
+    case 0:
+        memset(page, 0, PAGE_SIZE);
+        break;
+    case 1:
+        for (ofs = 0; ofs < PAGE_SIZE; ofs += sizeof(uint64_t))
+            *(uint64_t*)(page + ofs) = 0x0123456789abcdefULL * i;
+        break;
+    case 2:
+        for (ofs = 0; ofs < PAGE_SIZE; ofs += 64)
+            snprintf((char*)page + ofs, 64, "page %u, line %u: the quick brown fox jumps", (unsigned)i,
+                     (unsigned)(ofs / 64));
+        break;
+    default:
+        random_init(i);
+        random_bytes(page, PAGE_SIZE);
+        break;
+    }
+}
+
+void test_main(void)
+{
+    static uint8_t expect[PAGE_SIZE];
+    size_t i, round;
+
+    msg("write");
+    for (i = 0; i < PAGES; i++)
+        fill(i, buf + i * PAGE_SIZE);
+
+    for (round = 0; round < 2; round++) {
+        msg("check, round %zu", round);
+        for (i = 0; i < PAGES; i++) {
+            fill(i, expect);
+            if (memcmp(buf + i * PAGE_SIZE, expect, PAGE_SIZE))
+                fail("page %zu differs", i);
+        }
+    }
+}
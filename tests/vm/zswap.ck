@@ -0,0 +1,29 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+my ($stores) = grep (/^Zswap: .* stores/, @output);
+my ($loads) = grep (/^Zswap: .* hit rate/, @output);
+fail "missing compressed swap cache statistics"
+  unless defined $stores && defined $loads;
+fail "no same-filled pages stored: $stores"
+  unless $stores =~ /\((\d+) same-filled\)/ && $1 > 0;
+fail "cache never wrote back to disk: $stores"
+  unless $stores =~ /(\d+) writebacks/ && $1 > 0;
+fail "no loads hit the cache: $loads"
+  unless $loads =~ /(\d+) hits/ && $1 > 0;
+
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(zswap) begin
+(zswap) write
+(zswap) check, round 0
+(zswap) check, round 1
+(zswap) end
+EOF
+pass;
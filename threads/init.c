@@ -21,6 +21,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/vmalloc.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -30,7 +31,9 @@
 #endif
 #include "tests/threads/tests.h"
 #ifdef VM
+#include "vm/kswapd.h"
 #include "vm/vm.h"
+#include "vm/zswap.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
@@ -85,6 +88,7 @@ int main(void)
     mem_end = palloc_init();
     malloc_init();
     paging_init(mem_end);
+    vmalloc_init();
 
 #ifdef USERPROG
     tss_init();
@@ -225,6 +229,29 @@ static char** parse_options(char** argv)
             user_page_limit = atoi(value);
         else if (!strcmp(name, "-threads-tests"))
             thread_tests = true;
+#endif
+#ifdef VM
+        else if (!strcmp(name, "-vmp")) {
+            if (value == NULL || !replace_select(value))
+                PANIC("unknown replacement policy `%s'", value != NULL ? value : "");
+        } else if (!strcmp(name, "-wm")) {
+            char* high = value != NULL ? strchr(value, ',') : NULL;
+
+            if (high == NULL || !kswapd_set_watermarks(atoi(value), atoi(high + 1)))
+                PANIC("bad watermarks `%s'", value != NULL ? value : "");
+        } else if (!strcmp(name, "-zswap")) {
+            if (value == NULL)
+                PANIC("bad -zswap value");
+            zswap_set_max_pages(atoi(value));
+        } else if (!strcmp(name, "-ksm")) {
+            if (value == NULL)
+                PANIC("bad -ksm value");
+            ksm_set_rate(atoi(value));
+        } else if (!strcmp(name, "-ws")) {
+            if (value == NULL)
+                PANIC("bad -ws value");
+            rss_set_ws_interval(atoi(value));
+        }
 #endif
         else
             PANIC("unknown option `%s' (use -h for help)", name);
@@ -323,6 +350,13 @@ static void usage(void)
            "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
            "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+           "  -vmp=POLICY        Replace pages with POLICY: clock, 2q or arc.\n"
+           "  -wm=LOW,HIGH       Page out when fewer than LOW pages are free, up to HIGH.\n"
+           "  -zswap=PAGES       Cap compressed swap cache at PAGES pages (0 disables).\n"
+           "  -ksm=PAGES         Merge identical pages, scanning PAGES pages per second.\n"
+           "  -ws=TICKS          Estimate working sets every TICKS timer ticks.\n"
 #endif
     );
     power_off();
@@ -335,7 +369,9 @@ void power_off(void)
 #ifdef FILESYS
     filesys_done();
 #endif
+#ifdef VM
     cleanup_frame_table();
+#endif
 
     print_stats();
 
@@ -352,9 +388,27 @@ static void print_stats(void)
     thread_print_stats();
 #ifdef FILESYS
     disk_print_stats();
+#endif
+#ifdef VM
+    fault_print_stats();
 #endif
     console_print_stats();
     kbd_print_stats();
+    palloc_print_stats();
+    pml4_print_stats();
+    vmalloc_print_stats();
+#ifdef VM
+    swap_print_stats();
+    zswap_print_stats();
+    text_print_stats();
+    replace_print_stats();
+    kswapd_print_stats();
+    ksm_print_stats();
+    rss_print_stats();
+#endif
+#ifdef MALLOC_PROFILE
+    malloc_print_stats();
+#endif
 #ifdef USERPROG
     exception_print_stats();
 #endif
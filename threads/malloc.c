@@ -8,6 +8,7 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/vmalloc.h"
 
 /* A simple implementation of malloc().
 
@@ -30,9 +31,11 @@
 
    We can't handle blocks bigger than 2 kB using this scheme,
    because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   descriptor.  We handle those by allocating pages and sticking
+   the allocation size at the beginning of the allocated block's
+   arena header.  Blocks of more than one page come from
+   vmalloc(), which does not need physically contiguous memory,
+   and fall back to the page allocator only if that fails. */
 
 /* Descriptor. */
 struct desc {
@@ -64,6 +67,20 @@ static size_t desc_cnt;       /* Number of descriptors. */
 static struct arena* block_to_arena(struct block*);
 static struct block* arena_to_block(struct arena*, size_t idx);
 
+#ifdef MALLOC_PROFILE
+/* With the profiler compiled in, the arena allocator below is
+   renamed and malloc()/free() become wrappers that tag every
+   block with its call site.  See the end of this file. */
+static void* arena_malloc(size_t);
+static void arena_free(void*);
+static void* mprof_malloc(size_t, void* caller);
+static size_t mprof_size(void*);
+static void mprof_init(void);
+#else
+#define arena_malloc malloc
+#define arena_free free
+#endif
+
 /* Initializes the malloc() descriptors. */
 void malloc_init(void)
 {
@@ -77,11 +94,14 @@ void malloc_init(void)
         list_init(&d->free_list);
         lock_init(&d->lock);
     }
+#ifdef MALLOC_PROFILE
+    mprof_init();
+#endif
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
-void* malloc(size_t size)
+void* arena_malloc(size_t size)
 {
     struct desc* d;
     struct block* b;
@@ -100,7 +120,9 @@ void* malloc(size_t size)
         /* SIZE is too big for any descriptor.
            Allocate enough pages to hold SIZE plus an arena. */
         size_t page_cnt = DIV_ROUND_UP(size + sizeof *a, PGSIZE);
-        a = palloc_get_multiple(0, page_cnt);
+        a = page_cnt > 1 ? vmalloc(0, page_cnt) : NULL;
+        if (a == NULL)
+            a = palloc_get_multiple(0, page_cnt);
         if (a == NULL)
             return NULL;
 
@@ -156,7 +178,11 @@ void* calloc(size_t a, size_t b)
         return NULL;
 
     /* Allocate and zero memory. */
+#ifdef MALLOC_PROFILE
+    p = mprof_malloc(size, __builtin_return_address(0));
+#else
     p = malloc(size);
+#endif
     if (p != NULL)
         memset(p, 0, size);
 
@@ -185,9 +211,14 @@ void* realloc(void* old_block, size_t new_size)
         free(old_block);
         return NULL;
     } else {
+#ifdef MALLOC_PROFILE
+        void* new_block = mprof_malloc(new_size, __builtin_return_address(0));
+        size_t old_size = old_block != NULL ? mprof_size(old_block) : 0;
+#else
         void* new_block = malloc(new_size);
+        size_t old_size = old_block != NULL ? block_size(old_block) : 0;
+#endif
         if (old_block != NULL && new_block != NULL) {
-            size_t old_size = block_size(old_block);
             size_t min_size = new_size < old_size ? new_size : old_size;
             memcpy(new_block, old_block, min_size);
             free(old_block);
@@ -198,7 +229,7 @@ void* realloc(void* old_block, size_t new_size)
 
 /* Frees block P, which must have been previously allocated with
    malloc(), calloc(), or realloc(). */
-void free(void* p)
+void arena_free(void* p)
 {
     if (p != NULL) {
         struct block* b = p;
@@ -233,7 +264,10 @@ void free(void* p)
             lock_release(&d->lock);
         } else {
             /* It's a big block.  Free its pages. */
-            palloc_free_multiple(a, a->free_cnt);
+            if (is_vmalloc_vaddr(a))
+                vfree(a, a->free_cnt);
+            else
+                palloc_free_multiple(a, a->free_cnt);
             return;
         }
     }
@@ -263,3 +297,179 @@ static struct block* arena_to_block(struct arena* a, size_t idx)
     ASSERT(idx < a->desc->blocks_per_arena);
     return (struct block*)((uint8_t*)a + sizeof *a + idx * a->desc->block_size);
 }
+
+#ifdef MALLOC_PROFILE
+/* Allocation profiler.
+
+   Every block handed out by malloc() is preceded by a small tag
+   that names the call site (the caller's return address) that
+   allocated it.  Per call site we keep the number of live blocks
+   and bytes, the peak of the live bytes, and the total number of
+   allocations ever made.  malloc_print_stats() dumps the busiest
+   sites at shutdown; feed the addresses it prints to the
+   `backtrace' utility to turn them into function names.
+
+   The site table is a fixed open-addressed hash, since the
+   profiler cannot itself call malloc().  Sites that do not fit
+   are lumped together in slot 0. */
+
+#define MPROF_MAGIC 0x6d70726f /* Detects untagged or corrupt blocks. */
+#define MPROF_SITE_CNT 512     /* Size of the call site table. */
+#define MPROF_TOP_CNT 16       /* Rows printed by malloc_print_stats(). */
+
+/* Call site statistics. */
+struct mprof_site {
+    void* caller;      /* Return address of malloc()'s caller. */
+    size_t live_cnt;   /* Blocks currently allocated. */
+    size_t live_bytes; /* Bytes currently allocated. */
+    size_t peak_bytes; /* Maximum of live_bytes. */
+    size_t total_cnt;  /* Allocations ever made. */
+};
+
+/* Header in front of each profiled block.  16 bytes, so blocks
+   keep the alignment the arena allocator gives them. */
+struct mprof_tag {
+    uint32_t magic; /* Always MPROF_MAGIC while allocated. */
+    uint32_t site;  /* Index into mprof_sites. */
+    size_t size;    /* Requested size in bytes. */
+};
+
+static struct mprof_site mprof_sites[MPROF_SITE_CNT];
+static struct lock mprof_lock;
+
+static void mprof_init(void)
+{
+    lock_init(&mprof_lock);
+}
+
+/* Returns the slot for CALLER, claiming a free one if CALLER has
+   not been seen yet.  Must be called with mprof_lock held. */
+static size_t mprof_lookup(void* caller)
+{
+    size_t start = ((uintptr_t)caller >> 2) % (MPROF_SITE_CNT - 1) + 1;
+    size_t i = start;
+
+    do {
+        struct mprof_site* s = &mprof_sites[i];
+        if (s->caller == caller)
+            return i;
+        if (s->caller == NULL) {
+            s->caller = caller;
+            return i;
+        }
+        if (++i == MPROF_SITE_CNT)
+            i = 1;
+    } while (i != start);
+    return 0;
+}
+
+/* Allocates a SIZE-byte block on behalf of CALLER. */
+static void* mprof_malloc(size_t size, void* caller)
+{
+    struct mprof_tag* t;
+    struct mprof_site* s;
+
+    if (size == 0)
+        return NULL;
+    t = arena_malloc(size + sizeof *t);
+    if (t == NULL)
+        return NULL;
+
+    lock_acquire(&mprof_lock);
+    t->magic = MPROF_MAGIC;
+    t->site = mprof_lookup(caller);
+    t->size = size;
+    s = &mprof_sites[t->site];
+    s->live_cnt++;
+    s->live_bytes += size;
+    s->total_cnt++;
+    if (s->live_bytes > s->peak_bytes)
+        s->peak_bytes = s->live_bytes;
+    lock_release(&mprof_lock);
+    return t + 1;
+}
+
+/* Returns the tag in front of profiled block P. */
+static struct mprof_tag* mprof_tag(void* p)
+{
+    struct mprof_tag* t = (struct mprof_tag*)p - 1;
+
+    ASSERT(t->magic == MPROF_MAGIC);
+    ASSERT(t->site < MPROF_SITE_CNT);
+    return t;
+}
+
+/* Returns the number of bytes usable in profiled block P. */
+static size_t mprof_size(void* p)
+{
+    return block_size(mprof_tag(p)) - sizeof(struct mprof_tag);
+}
+
+void* malloc(size_t size)
+{
+    return mprof_malloc(size, __builtin_return_address(0));
+}
+
+void free(void* p)
+{
+    if (p != NULL) {
+        struct mprof_tag* t = mprof_tag(p);
+        struct mprof_site* s = &mprof_sites[t->site];
+
+        lock_acquire(&mprof_lock);
+        s->live_cnt--;
+        s->live_bytes -= t->size;
+        t->magic = 0;
+        lock_release(&mprof_lock);
+        arena_free(t);
+    }
+}
+
+/* Prints the MPROF_TOP_CNT call sites holding the most live
+   memory, ties broken by peak usage, followed by their addresses
+   in a form that can be pasted into `backtrace'. */
+void malloc_print_stats(void)
+{
+    size_t top[MPROF_TOP_CNT];
+    size_t top_cnt = 0;
+    size_t i, j;
+
+    lock_acquire(&mprof_lock);
+    for (i = 0; i < MPROF_SITE_CNT; i++) {
+        struct mprof_site* s = &mprof_sites[i];
+        if (s->total_cnt == 0)
+            continue;
+
+        /* Insertion into the sorted top list. */
+        for (j = top_cnt; j > 0; j--) {
+            struct mprof_site* t = &mprof_sites[top[j - 1]];
+            if (t->live_bytes > s->live_bytes || (t->live_bytes == s->live_bytes && t->peak_bytes >= s->peak_bytes))
+                break;
+            if (j < MPROF_TOP_CNT)
+                top[j] = top[j - 1];
+        }
+        if (j < MPROF_TOP_CNT) {
+            top[j] = i;
+            if (top_cnt < MPROF_TOP_CNT)
+                top_cnt++;
+        }
+    }
+
+    printf("Malloc: top %zu call sites by live bytes\n", top_cnt);
+    printf("  %-18s %8s %10s %10s %8s\n", "caller", "live", "live-bytes", "peak-bytes", "allocs");
+    for (i = 0; i < top_cnt; i++) {
+        struct mprof_site* s = &mprof_sites[top[i]];
+        if (s->caller != NULL)
+            printf("  %-18p", s->caller);
+        else
+            printf("  %-18s", "(other)");
+        printf(" %8zu %10zu %10zu %8zu\n", s->live_cnt, s->live_bytes, s->peak_bytes, s->total_cnt);
+    }
+    printf("Malloc call sites:");
+    for (i = 0; i < top_cnt; i++)
+        if (mprof_sites[top[i]].caller != NULL)
+            printf(" %p", mprof_sites[top[i]].caller);
+    printf("\n");
+    lock_release(&mprof_lock);
+}
+#endif /* MALLOC_PROFILE */
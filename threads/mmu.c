@@ -1,13 +1,118 @@
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Page-table page cache.
+ *
+ * Page-table pages come and go with every fork, exec and exit.
+ * Instead of going through palloc each time, freed table pages
+ * are parked on a dirty list, and are zeroed and moved to a clean
+ * list in batches once enough pile up; anything beyond the clean
+ * list's capacity goes back to palloc in the same pass.  A new
+ * table is then usually a pop from the clean list. */
+
+/* Clean pages to keep around. */
+#define PT_CLEAN_MAX 128
+
+/* Dirty pages that trigger a drain. */
+#define PT_DIRTY_MAX 64
+
+/* Free page-table pages, linked through their first word. */
+static uint64_t* pt_clean;
+static uint64_t* pt_dirty;
+static size_t pt_clean_cnt, pt_dirty_cnt;
+
+/* Statistics. */
+static long long pt_alloc_cnt, pt_hit_cnt;
+
+/* Kernel PML4 entries of base_pml4, copied into every new pml4. */
+static unsigned kernel_slots[PGSIZE / sizeof(uint64_t)];
+static size_t kernel_slot_cnt;
+
+/* Pops a page off the free list at *HEAD, or returns null. */
+static uint64_t* pt_pop(uint64_t** head, size_t* cnt)
+{
+    uint64_t* page;
+    enum intr_level old_level = intr_disable();
+
+    page = *head;
+    if (page != NULL) {
+        *head = (uint64_t*)page[0];
+        (*cnt)--;
+    }
+    intr_set_level(old_level);
+    return page;
+}
+
+static void pt_push(uint64_t** head, size_t* cnt, uint64_t* page)
+{
+    enum intr_level old_level = intr_disable();
+
+    page[0] = (uint64_t)*head;
+    *head = page;
+    (*cnt)++;
+    intr_set_level(old_level);
+}
+
+/* Returns a zeroed page for use as a page table, or a null
+ * pointer if memory is exhausted. */
+static uint64_t* pt_alloc(void)
+{
+    uint64_t* page;
+
+    pt_alloc_cnt++;
+    page = pt_pop(&pt_clean, &pt_clean_cnt);
+    if (page != NULL) {
+        pt_hit_cnt++;
+        page[0] = 0;
+        return page;
+    }
+    page = pt_pop(&pt_dirty, &pt_dirty_cnt);
+    if (page != NULL) {
+        pt_hit_cnt++;
+        memset(page, 0, PGSIZE);
+        return page;
+    }
+    return palloc_get_page(PAL_ZERO);
+}
+
+/* Releases page table PAGE.  The page is only recycled later, in
+ * pt_drain(). */
+static void pt_free(uint64_t* page)
+{
+    pt_push(&pt_dirty, &pt_dirty_cnt, page);
+}
+
+/* Zeroes dirty pages into the clean list until it is full and
+ * returns the rest to palloc. */
+static void pt_drain(void)
+{
+    uint64_t* page;
+
+    while ((page = pt_pop(&pt_dirty, &pt_dirty_cnt)) != NULL) {
+        if (pt_clean_cnt < PT_CLEAN_MAX) {
+            memset(page, 0, PGSIZE);
+            pt_push(&pt_clean, &pt_clean_cnt, page);
+        } else
+            palloc_free_page(page);
+    }
+}
+
+/* Prints page-table cache statistics. */
+void pml4_print_stats(void)
+{
+    printf("Page tables: %lld allocated, %lld from cache, %zu clean, %zu dirty\n", pt_alloc_cnt, pt_hit_cnt,
+           pt_clean_cnt, pt_dirty_cnt);
+}
+
 static uint64_t* pgdir_walk(uint64_t* pdp, const uint64_t va, int create)
 {
     int idx = PDX(va);
@@ -15,7 +120,7 @@ static uint64_t* pgdir_walk(uint64_t* pdp, const uint64_t va, int create)
         uint64_t* pte = (uint64_t*)pdp[idx];
         if (!((uint64_t)pte & PTE_P)) {
             if (create) {
-                uint64_t* new_page = palloc_get_page(PAL_ZERO);
+                uint64_t* new_page = pt_alloc();
                 if (new_page)
                     pdp[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
                 else
@@ -37,7 +142,7 @@ static uint64_t* pdpe_walk(uint64_t* pdpe, const uint64_t va, int create)
         uint64_t* pde = (uint64_t*)pdpe[idx];
         if (!((uint64_t)pde & PTE_P)) {
             if (create) {
-                uint64_t* new_page = palloc_get_page(PAL_ZERO);
+                uint64_t* new_page = pt_alloc();
                 if (new_page) {
                     pdpe[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
                     allocated = 1;
@@ -49,7 +154,7 @@ static uint64_t* pdpe_walk(uint64_t* pdpe, const uint64_t va, int create)
         pte = pgdir_walk(ptov(PTE_ADDR(pdpe[idx])), va, create);
     }
     if (pte == NULL && allocated) {
-        palloc_free_page((void*)ptov(PTE_ADDR(pdpe[idx])));
+        pt_free(ptov(PTE_ADDR(pdpe[idx])));
         pdpe[idx] = 0;
     }
     return pte;
@@ -70,7 +175,7 @@ uint64_t* pml4e_walk(uint64_t* pml4e, const uint64_t va, int create)
         uint64_t* pdpe = (uint64_t*)pml4e[idx];
         if (!((uint64_t)pdpe & PTE_P)) {
             if (create) {
-                uint64_t* new_page = palloc_get_page(PAL_ZERO);
+                uint64_t* new_page = pt_alloc();
                 if (new_page) {
                     pml4e[idx] = vtop(new_page) | PTE_U | PTE_W | PTE_P;
                     allocated = 1;
@@ -82,7 +187,7 @@ uint64_t* pml4e_walk(uint64_t* pml4e, const uint64_t va, int create)
         pte = pdpe_walk(ptov(PTE_ADDR(pml4e[idx])), va, create);
     }
     if (pte == NULL && allocated) {
-        palloc_free_page((void*)ptov(PTE_ADDR(pml4e[idx])));
+        pt_free(ptov(PTE_ADDR(pml4e[idx])));
         pml4e[idx] = 0;
     }
     return pte;
@@ -91,12 +196,23 @@ uint64_t* pml4e_walk(uint64_t* pml4e, const uint64_t va, int create)
 /* Creates a new page map level 4 (pml4) has mappings for kernel
  * virtual addresses, but none for user virtual addresses.
  * Returns the new page directory, or a null pointer if memory
- * allocation fails. */
+ * allocation fails.
+ * Only the kernel PML4 entries that base_pml4 populates are
+ * copied.  They are recorded on the first call, so base_pml4 must
+ * not gain new top-level entries once processes exist. */
 uint64_t* pml4_create(void)
 {
-    uint64_t* pml4 = palloc_get_page(0);
+    uint64_t* pml4 = pt_alloc();
+    size_t i;
+
+    if (kernel_slot_cnt == 0)
+        for (i = PML4(KERN_BASE); i < PGSIZE / sizeof(uint64_t); i++)
+            if (base_pml4[i] & PTE_P)
+                kernel_slots[kernel_slot_cnt++] = i;
+
     if (pml4)
-        memcpy(pml4, base_pml4, PGSIZE);
+        for (i = 0; i < kernel_slot_cnt; i++)
+            pml4[kernel_slots[i]] = base_pml4[kernel_slots[i]];
     return pml4;
 }
 
@@ -156,7 +272,7 @@ static void pt_destroy(uint64_t* pt)
         if (((uint64_t)pte) & PTE_P)
             palloc_free_page((void*)PTE_ADDR(pte));
     }
-    palloc_free_page((void*)pt);
+    pt_free(pt);
 }
 
 static void pgdir_destroy(uint64_t* pdp)
@@ -166,7 +282,7 @@ static void pgdir_destroy(uint64_t* pdp)
         if (((uint64_t)pte) & PTE_P)
             pt_destroy(PTE_ADDR(pte));
     }
-    palloc_free_page((void*)pdp);
+    pt_free(pdp);
 }
 
 static void pdpe_destroy(uint64_t* pdpe)
@@ -176,10 +292,12 @@ static void pdpe_destroy(uint64_t* pdpe)
         if (((uint64_t)pde) & PTE_P)
             pgdir_destroy((void*)PTE_ADDR(pde));
     }
-    palloc_free_page((void*)pdpe);
+    pt_free(pdpe);
 }
 
-/* Destroys pml4e, freeing all the pages it references. */
+/* Destroys pml4e, freeing all the pages it references.
+ * The page-table pages themselves are recycled in a batch once
+ * enough processes have exited. */
 void pml4_destroy(uint64_t* pml4)
 {
     if (pml4 == NULL)
@@ -190,7 +308,10 @@ void pml4_destroy(uint64_t* pml4)
     uint64_t* pdpe = ptov((uint64_t*)pml4[0]);
     if (((uint64_t)pdpe) & PTE_P)
         pdpe_destroy((void*)PTE_ADDR(pdpe));
-    palloc_free_page((void*)pml4);
+    pt_free(pml4);
+
+    if (pt_dirty_cnt >= PT_DIRTY_MAX)
+        pt_drain();
 }
 
 /* Loads page directory PD into the CPU's page directory base
@@ -256,6 +377,299 @@ void pml4_clear_page(uint64_t* pml4, void* upage)
     }
 }
 
+/* Range operations.
+ *
+ * Mapping N pages one at a time with pml4_set_page() walks all
+ * four levels N times.  The functions below instead keep a cursor
+ * on the page table that covers the current address, so only one
+ * PTE lookup in 512 goes through the upper levels.  Missing
+ * intermediate tables are counted first and then allocated as a
+ * batch, so running out of memory fails before any PTE changes. */
+
+/* Bytes of address space covered by one page table. */
+#define PT_SPAN (1UL << PDXSHIFT)
+
+/* Above this many pages, flush the whole TLB instead of
+ * invalidating page by page. */
+#define RANGE_FLUSH_PAGES 32
+
+/* Cursor on the last page table visited. */
+struct pt_cursor {
+    uint64_t* pml4;
+    uint64_t base; /* First address covered by PT. */
+    uint64_t* pt;  /* Null if no page table is cached. */
+};
+
+/* Page-table pages allocated ahead of use, linked through their
+ * first word. */
+struct pt_batch {
+    uint64_t* head;
+};
+
+static void cursor_init(struct pt_cursor* c, uint64_t* pml4)
+{
+    c->pml4 = pml4;
+    c->pt = NULL;
+}
+
+/* Returns the PTE for VA, or a null pointer if no page table
+ * covers VA.  Only walks from the root when VA leaves the page
+ * table of the previous call. */
+static uint64_t* cursor_pte(struct pt_cursor* c, uint64_t va)
+{
+    uint64_t* pte;
+
+    if (c->pt != NULL && va - c->base < PT_SPAN)
+        return &c->pt[PTX(va)];
+
+    pte = pml4e_walk(c->pml4, va, false);
+    if (pte == NULL) {
+        c->pt = NULL;
+        return NULL;
+    }
+    c->pt = pte - PTX(va);
+    c->base = va & ~(PT_SPAN - 1);
+    return pte;
+}
+
+/* Returns the first address past VA's page table. */
+static uint64_t next_pt(uint64_t va)
+{
+    return (va & ~(PT_SPAN - 1)) + PT_SPAN;
+}
+
+static uint64_t* batch_take(struct pt_batch* b)
+{
+    uint64_t* page = b->head;
+
+    ASSERT(page != NULL);
+    b->head = (uint64_t*)page[0];
+    page[0] = 0;
+    return page;
+}
+
+static void batch_free(struct pt_batch* b)
+{
+    while (b->head != NULL)
+        pt_free(batch_take(b));
+}
+
+/* Visits the entries of TABLE, a table at the level whose entries
+ * each cover 1 << SHIFT bytes, that overlap [START, END).  If
+ * LIKE is nonnull, it is the corresponding table of another
+ * pml4, and entries not present in LIKE are skipped.  Counts the
+ * missing tables below TABLE (a null TABLE is treated as empty)
+ * and, if B is nonnull, fills them in from B. */
+static size_t fill_tables(uint64_t* table, const uint64_t* like, unsigned shift, uint64_t start, uint64_t end,
+                          struct pt_batch* b)
+{
+    uint64_t span = 1UL << shift;
+    uint64_t va, next;
+    size_t cnt = 0;
+
+    for (va = start; va < end; va = next) {
+        unsigned idx = (va >> shift) & 0x1ff;
+        const uint64_t* like_child = NULL;
+        uint64_t* child = NULL;
+
+        next = (va & ~(span - 1)) + span;
+        if (next > end)
+            next = end;
+
+        if (like != NULL) {
+            if (!(like[idx] & PTE_P))
+                continue;
+            like_child = ptov(PTE_ADDR(like[idx]));
+        }
+
+        if (table != NULL && (table[idx] & PTE_P))
+            child = ptov(PTE_ADDR(table[idx]));
+        else {
+            cnt++;
+            if (b != NULL) {
+                child = batch_take(b);
+                table[idx] = vtop(child) | PTE_U | PTE_W | PTE_P;
+            }
+        }
+
+        if (shift > PDXSHIFT)
+            cnt += fill_tables(child, like_child, shift - 9, va, next, b);
+    }
+    return cnt;
+}
+
+/* Makes sure every page table needed to map [START, END) in PML4
+ * exists.  If LIKE is nonnull, only page tables that LIKE also
+ * has are created.  Returns false, leaving PML4 as it was, if
+ * memory runs out. */
+static bool prepare_tables(uint64_t* pml4, const uint64_t* like, uint64_t start, uint64_t end)
+{
+    struct pt_batch b = {NULL};
+    size_t cnt = fill_tables(pml4, like, PML4SHIFT, start, end, NULL);
+    size_t i;
+
+    for (i = 0; i < cnt; i++) {
+        uint64_t* page = pt_alloc();
+        if (page == NULL) {
+            batch_free(&b);
+            return false;
+        }
+        page[0] = (uint64_t)b.head;
+        b.head = page;
+    }
+    if (cnt > 0)
+        fill_tables(pml4, like, PML4SHIFT, start, end, &b);
+    ASSERT(b.head == NULL);
+    return true;
+}
+
+/* Invalidates the PAGE_CNT pages at UPAGE if PML4 is active. */
+static void flush_range(uint64_t* pml4, uint64_t upage, size_t page_cnt)
+{
+    size_t i;
+
+    if (rcr3() != vtop(pml4))
+        return;
+    if (page_cnt > RANGE_FLUSH_PAGES)
+        lcr3(rcr3());
+    else
+        for (i = 0; i < page_cnt; i++)
+            invlpg(upage + i * PGSIZE);
+}
+
+/* Maps the PAGE_CNT user pages starting at UPAGE in PML4 to the
+ * frames at kernel virtual addresses KPAGES[0...PAGE_CNT-1],
+ * read/write if RW is true.  None of the pages may be mapped
+ * already.  Returns true if successful, false if memory runs out
+ * or a page is already mapped, in which case no mapping is
+ * made. */
+bool pml4_map_range(uint64_t* pml4, void* upage, void* const kpages[], size_t page_cnt, bool rw)
+{
+    uint64_t start = (uint64_t)upage;
+    uint64_t end = start + page_cnt * PGSIZE;
+    struct pt_cursor c;
+    size_t i;
+
+    ASSERT(pg_ofs(upage) == 0);
+    ASSERT(page_cnt == 0 || is_user_vaddr(end - 1));
+    ASSERT(pml4 != base_pml4);
+
+    if (!prepare_tables(pml4, NULL, start, end))
+        return false;
+
+    cursor_init(&c, pml4);
+    for (i = 0; i < page_cnt; i++)
+        if (*cursor_pte(&c, start + i * PGSIZE) & PTE_P)
+            return false;
+    for (i = 0; i < page_cnt; i++) {
+        ASSERT(pg_ofs(kpages[i]) == 0);
+        *cursor_pte(&c, start + i * PGSIZE) = vtop(kpages[i]) | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+    }
+    return true;
+}
+
+/* Removes the mappings of the PAGE_CNT user pages starting at
+ * UPAGE from PML4.  The frames are not freed.  Unmapped pages in
+ * the range are ignored. */
+void pml4_unmap_range(uint64_t* pml4, void* upage, size_t page_cnt)
+{
+    uint64_t start = (uint64_t)upage;
+    uint64_t end = start + page_cnt * PGSIZE;
+    struct pt_cursor c;
+    uint64_t va;
+
+    ASSERT(pg_ofs(upage) == 0);
+    ASSERT(page_cnt == 0 || is_user_vaddr(end - 1));
+
+    cursor_init(&c, pml4);
+    for (va = start; va < end;) {
+        uint64_t* pte = cursor_pte(&c, va);
+        if (pte == NULL) {
+            va = next_pt(va);
+            continue;
+        }
+        *pte = 0;
+        va += PGSIZE;
+    }
+    flush_range(pml4, start, page_cnt);
+}
+
+/* Makes the mapped pages among the PAGE_CNT user pages starting
+ * at UPAGE in PML4 read/write if RW is true, read-only
+ * otherwise. */
+void pml4_protect_range(uint64_t* pml4, void* upage, size_t page_cnt, bool rw)
+{
+    uint64_t start = (uint64_t)upage;
+    uint64_t end = start + page_cnt * PGSIZE;
+    struct pt_cursor c;
+    uint64_t va;
+
+    ASSERT(pg_ofs(upage) == 0);
+    ASSERT(page_cnt == 0 || is_user_vaddr(end - 1));
+
+    cursor_init(&c, pml4);
+    for (va = start; va < end;) {
+        uint64_t* pte = cursor_pte(&c, va);
+        if (pte == NULL) {
+            va = next_pt(va);
+            continue;
+        }
+        if (*pte & PTE_P) {
+            if (rw)
+                *pte |= PTE_W;
+            else
+                *pte &= ~(uint64_t)PTE_W;
+        }
+        va += PGSIZE;
+    }
+    flush_range(pml4, start, page_cnt);
+}
+
+/* Copies the user pages mapped in SRC among the PAGE_CNT pages
+ * starting at UPAGE into DST: each gets a fresh page from the
+ * user pool holding the same data, mapped with the same
+ * permissions.  DST must not map any of them yet.  Returns false
+ * if memory runs out; pages copied so far stay mapped in DST. */
+bool pml4_copy_range(uint64_t* dst, uint64_t* src, void* upage, size_t page_cnt)
+{
+    uint64_t start = (uint64_t)upage;
+    uint64_t end = start + page_cnt * PGSIZE;
+    struct pt_cursor sc, dc;
+    uint64_t va;
+
+    ASSERT(pg_ofs(upage) == 0);
+    ASSERT(page_cnt == 0 || is_user_vaddr(end - 1));
+    ASSERT(dst != base_pml4);
+
+    if (!prepare_tables(dst, src, start, end))
+        return false;
+
+    cursor_init(&sc, src);
+    cursor_init(&dc, dst);
+    for (va = start; va < end;) {
+        uint64_t* spte = cursor_pte(&sc, va);
+        uint64_t* dpte;
+        void* kpage;
+
+        if (spte == NULL) {
+            va = next_pt(va);
+            continue;
+        }
+        if (*spte & PTE_P) {
+            dpte = cursor_pte(&dc, va);
+            ASSERT(dpte != NULL && !(*dpte & PTE_P));
+
+            kpage = palloc_get_page(PAL_USER);
+            if (kpage == NULL)
+                return false;
+            memcpy(kpage, ptov(PTE_ADDR(*spte)), PGSIZE);
+            *dpte = vtop(kpage) | (*spte & (PTE_P | PTE_W | PTE_U));
+        }
+        va += PGSIZE;
+    }
+    return true;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
  * that is, if the page has been modified since the PTE was
  * installed.
@@ -7,6 +7,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/init.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
@@ -23,24 +24,71 @@
    even if user processes are swapping like mad.
 
    By default, half of system RAM is given to the kernel pool and
-   half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   half to the user pool.  The split is only a starting point:
+   memory is owned in PALLOC_CHUNK_PAGES-page chunks, and whole
+   free chunks move between the pools as demand shifts.  Both
+   pools' bitmaps cover all of memory; pages in chunks that a
+   pool does not own are simply marked used in its bitmap.
+
+   A pool that drops below PALLOC_LOW_WMARK free pages takes a
+   free chunk from the other pool, as long as the donor stays
+   above PALLOC_HIGH_WMARK.  When an allocation fails outright,
+   the pool may take any free chunk, and asks the donor's
+   reclaim hook (see palloc_set_reclaim()) to empty one if none
+   is free. */
+
+/* Pages per ownership chunk (1 MB). */
+#define PALLOC_CHUNK_PAGES 256
+
+/* Free page watermarks that drive background rebalancing. */
+#define PALLOC_LOW_WMARK (PALLOC_CHUNK_PAGES / 4)
+#define PALLOC_HIGH_WMARK (PALLOC_CHUNK_PAGES * 2)
 
 /* A memory pool. */
 struct pool {
-    struct lock lock;        /* Mutual exclusion. */
-    struct bitmap* used_map; /* Bitmap of free pages. */
-    uint8_t* base;           /* Base of pool. */
+    struct lock lock;                /* Mutual exclusion. */
+    struct bitmap* used_map;         /* Bitmap of free pages. */
+    uint8_t* base;                   /* Base of pool. */
+    size_t page_cnt;                 /* Usable pages currently owned. */
+    size_t free_cnt;                 /* Of those, pages not allocated. */
+    size_t max_pages;                /* Never grow beyond this. */
+    palloc_reclaim_func* reclaim;    /* Empties pages on request. */
+    const char* name;                /* For statistics. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Chunk ownership: bit set if the chunk belongs to user_pool. */
+static struct bitmap* user_chunks;
+
+/* Bit set for every page that is real, usable memory.  Holes in
+   the e820 map and the kernel image stay marked used in both
+   pools forever, and must not stop a chunk from moving. */
+static struct bitmap* usable_map;
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
-static void init_pool(struct pool* p, void** bm_base, uint64_t start, uint64_t end);
 
+/* Pool size history, one sample per chunk move. */
+#define POOL_HISTORY_CNT 16
+struct pool_sample {
+    int64_t tick;       /* Timer tick of the move. */
+    size_t kernel_cnt;  /* Kernel pool pages afterward. */
+    size_t user_cnt;    /* User pool pages afterward. */
+};
+static struct pool_sample pool_history[POOL_HISTORY_CNT];
+static size_t pool_history_cnt;
+static long long chunks_to_kernel, chunks_to_user;
+
+static void init_pool(struct pool* p, void** bm_base, uint64_t start, uint64_t end);
+static void mark_free(uint64_t start, uint64_t end);
 static bool page_from_pool(const struct pool*, void* page);
+static struct pool* other_pool(struct pool*);
+static void rebalance(struct pool*);
+static bool pool_grow(struct pool*);
+static bool move_chunk(struct pool* from, struct pool* to, size_t chunk);
+static void record_sample(void);
 
 /* multiboot info */
 struct multiboot_info {
@@ -117,6 +165,8 @@ static void resolve_area_info(struct area* base_mem, struct area* ext_mem)
  * All the pages are manged by this allocator, even include code page.
  * Basically, give half of memory to kernel, half to user.
  * We push base_mem portion to the kernel as much as possible.
+ * The split is rounded up to a chunk boundary so every chunk has
+ * a single owner.
  */
 static void populate_pools(struct area* base_mem, struct area* ext_mem)
 {
@@ -127,15 +177,11 @@ static void populate_pools(struct area* base_mem, struct area* ext_mem)
     uint64_t user_pages = total_pages / 2 > user_page_limit ? user_page_limit : total_pages / 2;
     uint64_t kern_pages = total_pages - user_pages;
 
-    // Parse E820 map to claim the memory region for each pool.
-    enum {
-        KERN_START,
-        KERN,
-        USER_START,
-        USER
-    } state = KERN_START;
+    // Parse E820 map to find the extent of memory and the address at
+    // which the first KERN_PAGES usable pages end.
     uint64_t rem = kern_pages;
-    uint64_t region_start = 0, end = 0, start, size, size_in_pg;
+    uint64_t span_start = 0, span_end = 0, split = 0, start, size, size_in_pg;
+    bool found_start = false, found_split = false;
 
     struct multiboot_info* mb_info = ptov(MULTIBOOT_INFO);
     struct e820_entry* entries = ptov(mb_info->mmap_base);
@@ -146,57 +192,54 @@ static void populate_pools(struct area* base_mem, struct area* ext_mem)
         if (entry->type == ACPI_RECLAIMABLE || entry->type == USABLE) {
             start = (uint64_t)ptov(APPEND_HILO(entry->mem_hi, entry->mem_lo));
             size = APPEND_HILO(entry->len_hi, entry->len_lo);
-            end = start + size;
             size_in_pg = size / PGSIZE;
 
-            if (state == KERN_START) {
-                region_start = start;
-                state = KERN;
+            if (!found_start) {
+                span_start = start;
+                found_start = true;
             }
+            span_end = start + size;
 
-            switch (state) {
-            case KERN:
-                if (rem > size_in_pg) {
+            if (!found_split) {
+                if (rem <= size_in_pg) {
+                    split = start + rem * PGSIZE;
+                    found_split = true;
+                } else
                     rem -= size_in_pg;
-                    break;
-                }
-                // generate kernel pool
-                init_pool(&kernel_pool, &free_start, region_start, start + rem * PGSIZE);
-                // Transition to the next state
-                if (rem == size_in_pg) {
-                    rem = user_pages;
-                    state = USER_START;
-                } else {
-                    region_start = start + rem * PGSIZE;
-                    rem = user_pages - size_in_pg + rem;
-                    state = USER;
-                }
-                break;
-            case USER_START:
-                region_start = start;
-                state = USER;
-                break;
-            case USER:
-                if (rem > size_in_pg) {
-                    rem -= size_in_pg;
-                    break;
-                }
-                ASSERT(rem == size);
-                break;
-            default:
-                NOT_REACHED();
             }
         }
     }
-
-    // generate the user pool
-    init_pool(&user_pool, &free_start, region_start, end);
+    if (!found_split)
+        split = span_end;
+    split = span_start + ROUND_UP(split - span_start, (uint64_t)PALLOC_CHUNK_PAGES * PGSIZE);
+    if (split > span_end)
+        split = span_end;
+
+    // Both pools span all of memory; chunk ownership decides who may
+    // use which pages.
+    size_t span_pages = (span_end - span_start) / PGSIZE;
+    size_t chunk_cnt = DIV_ROUND_UP(span_pages, PALLOC_CHUNK_PAGES);
+    size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(chunk_cnt), PGSIZE) * PGSIZE;
+    size_t usable_bm_pages = DIV_ROUND_UP(bitmap_buf_size(span_pages), PGSIZE) * PGSIZE;
+
+    init_pool(&kernel_pool, &free_start, span_start, span_end);
+    init_pool(&user_pool, &free_start, span_start, span_end);
+    kernel_pool.name = "kernel";
+    user_pool.name = "user";
+    kernel_pool.max_pages = SIZE_MAX;
+    user_pool.max_pages = user_page_limit;
+
+    user_chunks = bitmap_create_in_buf(chunk_cnt, free_start, bm_pages);
+    bitmap_set_multiple(user_chunks, 0, chunk_cnt, false);
+    bitmap_set_multiple(user_chunks, (split - span_start) / PGSIZE / PALLOC_CHUNK_PAGES,
+                        chunk_cnt - (split - span_start) / PGSIZE / PALLOC_CHUNK_PAGES, true);
+    free_start += bm_pages;
+    usable_map = bitmap_create_in_buf(span_pages, free_start, usable_bm_pages);
+    bitmap_set_all(usable_map, false);
+    free_start += usable_bm_pages;
 
     // Iterate over the e820_entry. Setup the usable.
     uint64_t usable_bound = (uint64_t)free_start;
-    struct pool* pool;
-    void* pool_end;
-    size_t page_idx, page_cnt;
 
     for (i = 0; i < mb_info->mmap_len / sizeof(struct e820_entry); i++) {
         struct e820_entry* entry = &entries[i];
@@ -211,27 +254,33 @@ static void populate_pools(struct area* base_mem, struct area* ext_mem)
                 continue;
 
             start = (uint64_t)pg_round_up(start >= usable_bound ? start : usable_bound);
-        split:
-            if (page_from_pool(&kernel_pool, (void*)start))
-                pool = &kernel_pool;
-            else if (page_from_pool(&user_pool, (void*)start))
-                pool = &user_pool;
-            else
-                NOT_REACHED();
-
-            pool_end = pool->base + bitmap_size(pool->used_map) * PGSIZE;
-            page_idx = pg_no(start) - pg_no(pool->base);
-            if ((uint64_t)pool_end < end) {
-                page_cnt = ((uint64_t)pool_end - start) / PGSIZE;
-                bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
-                start = (uint64_t)pool_end;
-                goto split;
-            } else {
-                page_cnt = ((uint64_t)end - start) / PGSIZE;
-                bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
-            }
+            mark_free(start, end);
         }
     }
+    record_sample();
+}
+
+/* Marks the pages in [START, END) free in whichever pool owns
+ * each of them. */
+static void mark_free(uint64_t start, uint64_t end)
+{
+    while (start + PGSIZE <= end) {
+        struct pool* pool = page_from_pool(&kernel_pool, (void*)start) ? &kernel_pool : &user_pool;
+        size_t page_idx = pg_no(start) - pg_no(pool->base);
+        size_t chunk_end = ROUND_DOWN(page_idx, PALLOC_CHUNK_PAGES) + PALLOC_CHUNK_PAGES;
+        size_t page_cnt = (end - start) / PGSIZE;
+
+        ASSERT(page_from_pool(pool, (void*)start));
+        if (page_cnt > chunk_end - page_idx)
+            page_cnt = chunk_end - page_idx;
+        if (page_cnt > bitmap_size(pool->used_map) - page_idx)
+            page_cnt = bitmap_size(pool->used_map) - page_idx;
+        bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+        bitmap_set_multiple(usable_map, page_idx, page_cnt, true);
+        pool->page_cnt += page_cnt;
+        pool->free_cnt += page_cnt;
+        start += page_cnt * PGSIZE;
+    }
 }
 
 /* Initializes the page allocator and get the memory size */
@@ -260,12 +309,21 @@ uint64_t palloc_init(void)
 void* palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
 {
     struct pool* pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-    lock_acquire(&pool->lock);
-    size_t page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
-    lock_release(&pool->lock);
+    size_t page_idx;
     void* pages;
 
+    for (;;) {
+        lock_acquire(&pool->lock);
+        page_idx = bitmap_scan_and_flip(pool->used_map, 0, page_cnt, false);
+        if (page_idx != BITMAP_ERROR)
+            pool->free_cnt -= page_cnt;
+        lock_release(&pool->lock);
+
+        /* Out of pages: take a chunk from the other pool and retry. */
+        if (page_idx != BITMAP_ERROR || page_cnt > PALLOC_CHUNK_PAGES || !pool_grow(pool))
+            break;
+    }
+
     if (page_idx != BITMAP_ERROR)
         pages = pool->base + PGSIZE * page_idx;
     else
@@ -274,6 +332,8 @@ void* palloc_get_multiple(enum palloc_flags flags, size_t page_cnt)
     if (pages) {
         if (flags & PAL_ZERO)
             memset(pages, 0, PGSIZE * page_cnt);
+        if (pool->free_cnt < PALLOC_LOW_WMARK)
+            rebalance(pool);
     } else {
         if (flags & PAL_ASSERT)
             PANIC("palloc_get: out of pages");
@@ -316,8 +376,11 @@ void palloc_free_multiple(void* pages, size_t page_cnt)
 #ifndef NDEBUG
     memset(pages, 0xcc, PGSIZE * page_cnt);
 #endif
+    lock_acquire(&pool->lock);
     ASSERT(bitmap_all(pool->used_map, page_idx, page_cnt));
     bitmap_set_multiple(pool->used_map, page_idx, page_cnt, false);
+    pool->free_cnt += page_cnt;
+    lock_release(&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -326,6 +389,55 @@ void palloc_free_page(void* page)
     palloc_free_multiple(page, 1);
 }
 
+/* Returns the number of pages the pool selected by FLAGS
+   (PAL_USER or not) currently owns. */
+size_t palloc_pool_pages(enum palloc_flags flags)
+{
+    return (flags & PAL_USER ? &user_pool : &kernel_pool)->page_cnt;
+}
+
+/* Returns roughly how many pages an allocation from the pool
+   selected by FLAGS (PAL_USER or not) can still get without
+   anything being reclaimed: the pool's free pages, plus those it
+   could take from the other pool while the donor stays above
+   PALLOC_HIGH_WMARK.  Taken without locks, so only an estimate. */
+size_t palloc_free_pages(enum palloc_flags flags)
+{
+    struct pool* pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    struct pool* donor = pool == &user_pool ? &kernel_pool : &user_pool;
+    size_t spare = donor->free_cnt > PALLOC_HIGH_WMARK ? donor->free_cnt - PALLOC_HIGH_WMARK : 0;
+    size_t room = pool->max_pages > pool->page_cnt ? pool->max_pages - pool->page_cnt : 0;
+
+    return pool->free_cnt + ROUND_DOWN(spare < room ? spare : room, PALLOC_CHUNK_PAGES);
+}
+
+/* Registers FUNC as the reclaim hook of the pool selected by
+   FLAGS (PAL_USER or not).  When the other pool runs dry and no
+   chunk of this pool is free, FUNC is asked to release the pages
+   of one chunk so that the chunk can change hands. */
+void palloc_set_reclaim(enum palloc_flags flags, palloc_reclaim_func* func)
+{
+    struct pool* pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+    pool->reclaim = func;
+}
+
+/* Prints pool sizes and the history of chunk moves. */
+void palloc_print_stats(void)
+{
+    struct pool* pools[] = {&kernel_pool, &user_pool};
+    size_t i, first;
+
+    for (i = 0; i < sizeof pools / sizeof *pools; i++)
+        printf("Palloc: %s pool %zu pages, %zu free\n", pools[i]->name, pools[i]->page_cnt, pools[i]->free_cnt);
+    printf("Palloc: %lld chunks moved to kernel, %lld to user\n", chunks_to_kernel, chunks_to_user);
+
+    first = pool_history_cnt > POOL_HISTORY_CNT ? pool_history_cnt - POOL_HISTORY_CNT : 0;
+    for (i = first; i < pool_history_cnt; i++) {
+        struct pool_sample* ps = &pool_history[i % POOL_HISTORY_CNT];
+        printf("  tick %8lld: kernel %6zu pages, user %6zu pages\n", ps->tick, ps->kernel_cnt, ps->user_cnt);
+    }
+}
+
 /* Initializes pool P as starting at START and ending at END */
 static void init_pool(struct pool* p, void** bm_base, uint64_t start, uint64_t end)
 {
@@ -338,6 +450,7 @@ static void init_pool(struct pool* p, void** bm_base, uint64_t start, uint64_t e
     lock_init(&p->lock);
     p->used_map = bitmap_create_in_buf(pgcnt, *bm_base, bm_pages);
     p->base = (void*)start;
+    p->page_cnt = p->free_cnt = 0;
 
     // Mark all to unusable.
     bitmap_set_all(p->used_map, true);
@@ -352,10 +465,136 @@ static bool page_from_pool(const struct pool* pool, void* page)
     size_t page_no = pg_no(page);
     size_t start_page = pg_no(pool->base);
     size_t end_page = start_page + bitmap_size(pool->used_map);
-    return page_no >= start_page && page_no < end_page;
+
+    if (page_no < start_page || page_no >= end_page)
+        return false;
+    return bitmap_test(user_chunks, (page_no - start_page) / PALLOC_CHUNK_PAGES) == (pool == &user_pool);
+}
+
+/* Returns the pool that is not P. */
+static struct pool* other_pool(struct pool* p)
+{
+    return p == &user_pool ? &kernel_pool : &user_pool;
+}
+
+/* P is low on free pages.  Move a free chunk over from the other
+   pool if that one has pages to spare. */
+static void rebalance(struct pool* p)
+{
+    struct pool* donor = other_pool(p);
+    size_t chunk_cnt = bitmap_size(user_chunks);
+    size_t i;
+
+    if (donor->free_cnt < PALLOC_HIGH_WMARK + PALLOC_CHUNK_PAGES)
+        return;
+    for (i = 0; i < chunk_cnt; i++)
+        if (move_chunk(donor, p, i))
+            return;
+}
+
+/* P could not satisfy an allocation.  Takes any free chunk from
+   the other pool, or failing that asks the other pool's reclaim
+   hook to empty its least used chunk and takes that.  Returns
+   true if P gained a chunk. */
+static bool pool_grow(struct pool* p)
+{
+    struct pool* donor = other_pool(p);
+    size_t chunk_cnt = bitmap_size(user_chunks);
+    size_t best = BITMAP_ERROR, best_free = 0;
+    size_t i;
+
+    for (i = 0; i < chunk_cnt; i++)
+        if (move_chunk(donor, p, i))
+            return true;
+    if (donor->reclaim == NULL)
+        return false;
+
+    /* No free chunk: pick the donor chunk with the most free pages. */
+    lock_acquire(&donor->lock);
+    for (i = 0; i < chunk_cnt; i++) {
+        size_t start = i * PALLOC_CHUNK_PAGES;
+        size_t cnt = bitmap_size(donor->used_map) - start;
+        size_t free;
+
+        if (bitmap_test(user_chunks, i) != (donor == &user_pool))
+            continue;
+        if (cnt > PALLOC_CHUNK_PAGES)
+            cnt = PALLOC_CHUNK_PAGES;
+        free = bitmap_count(donor->used_map, start, cnt, false);
+        if (best == BITMAP_ERROR || free > best_free) {
+            best = i;
+            best_free = free;
+        }
+    }
+    lock_release(&donor->lock);
+    if (best == BITMAP_ERROR)
+        return false;
+
+    donor->reclaim(donor->base + best * PALLOC_CHUNK_PAGES * PGSIZE, PALLOC_CHUNK_PAGES);
+    return move_chunk(donor, p, best);
+}
+
+/* Moves CHUNK from pool FROM to pool TO if FROM owns it and none
+   of its pages are allocated.  Returns true if successful. */
+static bool move_chunk(struct pool* from, struct pool* to, size_t chunk)
+{
+    size_t start = chunk * PALLOC_CHUNK_PAGES;
+    size_t cnt = bitmap_size(from->used_map) - start;
+    size_t free, i;
+    bool moved = false;
+
+    if (cnt > PALLOC_CHUNK_PAGES)
+        cnt = PALLOC_CHUNK_PAGES;
+
+    /* Lock in a fixed order: kernel pool, then user pool. */
+    lock_acquire(&kernel_pool.lock);
+    lock_acquire(&user_pool.lock);
+    if (bitmap_test(user_chunks, chunk) == (from == &user_pool) && to->page_cnt + cnt <= to->max_pages) {
+        free = bitmap_count(from->used_map, start, cnt, false);
+        if (free > 0 && free == bitmap_count(usable_map, start, cnt, true)) {
+            for (i = start; i < start + cnt; i++)
+                if (!bitmap_test(from->used_map, i)) {
+                    bitmap_mark(from->used_map, i);
+                    bitmap_reset(to->used_map, i);
+                }
+            bitmap_flip(user_chunks, chunk);
+            from->page_cnt -= free;
+            from->free_cnt -= free;
+            to->page_cnt += free;
+            to->free_cnt += free;
+            if (to == &kernel_pool)
+                chunks_to_kernel++;
+            else
+                chunks_to_user++;
+            moved = true;
+        }
+    }
+    lock_release(&user_pool.lock);
+    lock_release(&kernel_pool.lock);
+
+    if (moved)
+        record_sample();
+    return moved;
+}
+
+/* Appends the current pool sizes to the history. */
+static void record_sample(void)
+{
+    struct pool_sample* ps = &pool_history[pool_history_cnt++ % POOL_HISTORY_CNT];
+
+    ps->tick = timer_ticks();
+    ps->kernel_cnt = kernel_pool.page_cnt;
+    ps->user_cnt = user_pool.page_cnt;
 }
 
 size_t user_pool_pages(void)
 {
     return bitmap_size(user_pool.used_map);
-}
\ No newline at end of file
+}
+
+/* Returns the address of the first of the user_pool_pages() pages
+   the user pool can ever hold. */
+void* user_pool_base(void)
+{
+    return user_pool.base;
+}
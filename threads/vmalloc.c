@@ -0,0 +1,207 @@
+#include "threads/vmalloc.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "intrinsic.h"
+
+/* Noncontiguous kernel allocator.
+
+   palloc_get_multiple() must find PAGE_CNT physically contiguous
+   free pages, which a fragmented kernel pool often cannot offer
+   even when plenty of single pages are free.  vmalloc() instead
+   takes PAGE_CNT individual pages from the kernel pool and maps
+   them back to back into a reserved window of kernel virtual
+   memory.  The window's page tables hang off base_pml4's kernel
+   PML4 entry, which every process pml4 shares, so a mapping made
+   here is immediately visible in all address spaces.
+
+   Memory from vmalloc() is virtually but not physically
+   contiguous: never hand it to vtop().
+
+   TLB invalidation is lazy.  vfree() clears the PTEs and returns
+   the pages to palloc right away, but keeps the virtual range
+   reserved ("stale") instead of flushing each address.  When
+   enough stale pages pile up, or an allocation cannot find room,
+   we flush the whole TLB once and release every stale range.
+   Touching freed vmalloc() memory is a use-after-free bug either
+   way, so the stale translations are harmless. */
+
+/* Stale pages that trigger a TLB flush on the next vfree(). */
+#define VMALLOC_LAZY_MAX 512
+
+static struct lock vmalloc_lock;
+static struct bitmap* used_map;  /* Window pages that are reserved. */
+static struct bitmap* stale_map; /* Reserved only until next flush. */
+static size_t stale_cnt;         /* Number of bits set in stale_map. */
+
+/* Statistics. */
+static long long alloc_cnt, free_cnt, flush_cnt;
+static size_t mapped_pages, peak_pages;
+
+static void purge_stale(void);
+static void unmap_pages(void* pages, size_t page_cnt);
+static uint64_t* window_pte(void* va, bool create);
+
+/* Sets up the vmalloc() window.  Must run after paging_init(). */
+void vmalloc_init(void)
+{
+    size_t bm_pages = DIV_ROUND_UP(bitmap_buf_size(VMALLOC_PAGES), PGSIZE);
+    uint8_t* va;
+
+    lock_init(&vmalloc_lock);
+    used_map = bitmap_create_in_buf(VMALLOC_PAGES, palloc_get_multiple(PAL_ASSERT, bm_pages), bm_pages * PGSIZE);
+    stale_map = bitmap_create_in_buf(VMALLOC_PAGES, palloc_get_multiple(PAL_ASSERT, bm_pages), bm_pages * PGSIZE);
+    bitmap_set_all(used_map, false);
+    bitmap_set_all(stale_map, false);
+
+    /* Build every page table of the window now: its PML4 entry
+       must exist before pml4_create() records which kernel entries
+       new address spaces share, and with all tables in place
+       vmalloc() only ever fills in PTEs, so concurrent callers
+       cannot race to create the same table. */
+    for (va = (uint8_t*)VMALLOC_START; va < (uint8_t*)VMALLOC_END; va += 1UL << PDXSHIFT)
+        if (window_pte(va, true) == NULL)
+            PANIC("vmalloc: cannot map window");
+}
+
+/* Obtains PAGE_CNT pages from the kernel pool, maps them at
+   consecutive addresses in the vmalloc() window and returns the
+   first address.  PAL_ZERO zeroes the memory and PAL_ASSERT
+   panics on failure, as for palloc_get_multiple(); PAL_USER is
+   not allowed.  Returns a null pointer if the window or the
+   kernel pool is exhausted, or before vmalloc_init(). */
+void* vmalloc(enum palloc_flags flags, size_t page_cnt)
+{
+    size_t idx, i;
+    uint8_t* va;
+
+    ASSERT(!(flags & PAL_USER));
+    if (used_map == NULL || page_cnt == 0)
+        goto fail;
+
+    lock_acquire(&vmalloc_lock);
+    idx = bitmap_scan_and_flip(used_map, 0, page_cnt, false);
+    if (idx == BITMAP_ERROR && stale_cnt > 0) {
+        purge_stale();
+        idx = bitmap_scan_and_flip(used_map, 0, page_cnt, false);
+    }
+    lock_release(&vmalloc_lock);
+    if (idx == BITMAP_ERROR)
+        goto fail;
+
+    va = (uint8_t*)VMALLOC_START + idx * PGSIZE;
+    for (i = 0; i < page_cnt; i++) {
+        void* kpage = palloc_get_page(flags & PAL_ZERO);
+        uint64_t* pte = window_pte(va + i * PGSIZE, false);
+
+        ASSERT(pte != NULL);
+        if (kpage == NULL) {
+            /* Give back what was mapped so far; it was never
+               counted in MAPPED_PAGES. */
+            unmap_pages(va, i);
+            lock_acquire(&vmalloc_lock);
+            bitmap_set_multiple(stale_map, idx, i, true);
+            stale_cnt += i;
+            bitmap_set_multiple(used_map, idx + i, page_cnt - i, false);
+            lock_release(&vmalloc_lock);
+            goto fail;
+        }
+        *pte = vtop(kpage) | PTE_P | PTE_W;
+    }
+
+    lock_acquire(&vmalloc_lock);
+    alloc_cnt++;
+    mapped_pages += page_cnt;
+    if (mapped_pages > peak_pages)
+        peak_pages = mapped_pages;
+    lock_release(&vmalloc_lock);
+    return va;
+
+fail:
+    if (flags & PAL_ASSERT)
+        PANIC("vmalloc: out of pages");
+    return NULL;
+}
+
+/* Unmaps and frees the PAGE_CNT pages starting at PAGES, which
+   must have been obtained from vmalloc(). */
+void vfree(void* pages, size_t page_cnt)
+{
+    size_t idx;
+
+    if (pages == NULL || page_cnt == 0)
+        return;
+    ASSERT(is_vmalloc_vaddr(pages));
+    ASSERT(pg_ofs(pages) == 0);
+
+    unmap_pages(pages, page_cnt);
+
+    idx = pg_no(pages) - pg_no(VMALLOC_START);
+    lock_acquire(&vmalloc_lock);
+    ASSERT(bitmap_all(used_map, idx, page_cnt));
+    bitmap_set_multiple(stale_map, idx, page_cnt, true);
+    stale_cnt += page_cnt;
+    mapped_pages -= page_cnt;
+    free_cnt++;
+    if (stale_cnt >= VMALLOC_LAZY_MAX)
+        purge_stale();
+    lock_release(&vmalloc_lock);
+}
+
+/* Prints vmalloc() statistics. */
+void vmalloc_print_stats(void)
+{
+    printf("Vmalloc: %lld allocs, %lld frees, %lld TLB flushes, %zu pages mapped (peak %zu)\n", alloc_cnt, free_cnt,
+           flush_cnt, mapped_pages, peak_pages);
+}
+
+/* Flushes the TLB and makes every stale window page available
+   again.  Must be called with vmalloc_lock held. */
+static void purge_stale(void)
+{
+    size_t idx = 0;
+
+    ASSERT(lock_held_by_current_thread(&vmalloc_lock));
+
+    /* Reloading CR3 drops all non-global translations. */
+    lcr3(rcr3());
+    flush_cnt++;
+
+    while (stale_cnt > 0) {
+        idx = bitmap_scan(stale_map, idx, 1, true);
+        ASSERT(idx != BITMAP_ERROR);
+        bitmap_reset(stale_map, idx);
+        bitmap_reset(used_map, idx);
+        stale_cnt--;
+    }
+}
+
+/* Clears the PTEs of the PAGE_CNT window pages starting at PAGES
+   and returns the pages they mapped to palloc.  The range stays
+   reserved in USED_MAP. */
+static void unmap_pages(void* pages, size_t page_cnt)
+{
+    size_t i;
+
+    for (i = 0; i < page_cnt; i++) {
+        uint64_t* pte = window_pte((uint8_t*)pages + i * PGSIZE, false);
+
+        ASSERT(pte != NULL && (*pte & PTE_P));
+        palloc_free_page(ptov(PTE_ADDR(*pte)));
+        *pte = 0;
+    }
+}
+
+/* Returns the PTE that maps window address VA in base_pml4,
+   creating intermediate page tables if CREATE is true. */
+static uint64_t* window_pte(void* va, bool create)
+{
+    ASSERT(is_vmalloc_vaddr(va));
+    return pml4e_walk(base_pml4, (uint64_t)va, create);
+}
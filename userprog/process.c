@@ -155,46 +155,6 @@ tid_t process_fork(const char* name, struct intr_frame* if_ UNUSED)
     return child_tid;
 }
 
-#ifndef VM
-/* Duplicate the parent's address space by passing this function to the
- * pml4_for_each. This is only for the project 2. */
-static bool duplicate_pte(uint64_t* pte, void* va, void* aux)
-{
-    struct thread* current = thread_current();
-    struct thread* parent = (struct thread*)aux;
-    void* parent_page;
-    void* newpage;
-    bool writable;
-
-    /* 1. If the parent_page is kernel page, then return immediately. */
-    if (va < CODE_SEGMENT || va >= USER_STACK)
-        return true; /* 부모의 유저 공간만 복사하므로, 복사 대상이 아니면 건너뛰고 진행. */
-
-    /* 2. Resolve VA from the parent's page map level 4. */
-    parent_page = pml4_get_page(parent->pml4, va);
-    if (parent_page == NULL)
-        return false;
-
-    /* 3. Allocate new PAL_USER page for the child and set result to NEWPAGE. */
-    newpage = palloc_get_page(PAL_USER);
-    if (newpage == NULL)
-        return false;
-
-    /* 4. Duplicate parent's page to the new page and check whether parent's page is writable or not
-     *    (set WRITABLE according to the result). */
-    memcpy(newpage, parent_page, PGSIZE);
-    writable = is_writable(pte);
-
-    /* 5. Add new page to child's page table at address VA with WRITABLE permission. */
-    if (!pml4_set_page(current->pml4, va, newpage, writable)) {
-        /* 6. if fail to insert page, do error handling. */
-        palloc_free_page(newpage);
-        return false;
-    }
-    return true;
-}
-#endif
-
 /* A thread function that copies parent's execution context.
  * Hint) parent->tf does not hold the userland context of the process.
  *       That is, you are required to pass second argument of process_fork to
@@ -223,10 +183,12 @@ static void __do_fork(void* aux)
     process_activate(current);
 #ifdef VM
     supplemental_page_table_init(&current->spt);
+    rss_fork(current, parent);
     if (!supplemental_page_table_copy(&current->spt, &parent->spt))
         goto error;
 #else
-    if (!pml4_for_each(parent->pml4, duplicate_pte, parent))
+    /* Copy the parent's user pages into the child. */
+    if (!pml4_copy_range(current->pml4, parent->pml4, (void*)CODE_SEGMENT, (USER_STACK - CODE_SEGMENT) / PGSIZE))
         goto error;
 #endif
     /* 파일 복사 */
@@ -431,6 +393,9 @@ void process_exit(void)
     lock_release(&filesys_lock);
 
     process_cleanup();
+#ifdef VM
+    fault_stat_exit(curr);
+#endif
 }
 
 /* Free the current process's resources. */
@@ -678,8 +643,8 @@ static bool validate_segment(const struct Phdr* phdr, struct file* file)
  * If you want to implement the function for whole project 2, implement it
  * outside of #ifndef macro. */
 
-/* load() helpers. */
-static bool install_page(void* upage, void* kpage, bool writable);
+/* Pages that load_segment() reads before mapping them at once. */
+#define LOAD_BATCH_PAGES 32
 
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
@@ -698,6 +663,9 @@ static bool install_page(void* upage, void* kpage, bool writable);
 static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t read_bytes, uint32_t zero_bytes,
                          bool writable)
 {
+    void* kpages[LOAD_BATCH_PAGES];
+    size_t cnt = 0;
+
     ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
@@ -713,39 +681,44 @@ static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t
         /* Get a page of memory. */
         uint8_t* kpage = palloc_get_page(PAL_USER);
         if (kpage == NULL)
-            return false;
+            goto fail;
+        kpages[cnt++] = kpage;
 
         /* Load this page. */
-        if (file_read(file, kpage, page_read_bytes) != (int)page_read_bytes) {
-            palloc_free_page(kpage);
-            return false;
-        }
+        if (file_read(file, kpage, page_read_bytes) != (int)page_read_bytes)
+            goto fail;
         memset(kpage + page_read_bytes, 0, page_zero_bytes);
 
-        /* Add the page to the process's address space. */
-        if (!install_page(upage, kpage, writable)) {
-            printf("fail\n");
-            palloc_free_page(kpage);
-            return false;
-        }
-
         /* Advance. */
         read_bytes -= page_read_bytes;
         zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
+
+        /* Add a full batch, or the last pages, to the process's
+         * address space. */
+        if (cnt == LOAD_BATCH_PAGES || (read_bytes == 0 && zero_bytes == 0)) {
+            if (!pml4_map_range(thread_current()->pml4, upage, kpages, cnt, writable))
+                goto fail;
+            upage += cnt * PGSIZE;
+            cnt = 0;
+        }
     }
     return true;
+
+fail:
+    while (cnt > 0)
+        palloc_free_page(kpages[--cnt]);
+    return false;
 }
 
 /* Create a minimal stack by mapping a zeroed page at the USER_STACK */
 static bool setup_stack(struct intr_frame* if_)
 {
-    uint8_t* kpage;
+    void* kpage;
     bool success = false;
 
     kpage = palloc_get_page(PAL_USER | PAL_ZERO);
     if (kpage != NULL) {
-        success = install_page(((uint8_t*)USER_STACK) - PGSIZE, kpage, true);
+        success = pml4_map_range(thread_current()->pml4, ((uint8_t*)USER_STACK) - PGSIZE, &kpage, 1, true);
         if (success)
             if_->rsp = USER_STACK;
         else
@@ -753,54 +726,11 @@ static bool setup_stack(struct intr_frame* if_)
     }
     return success;
 }
-
-/* Adds a mapping from user virtual address UPAGE to kernel
- * virtual address KPAGE to the page table.
- * If WRITABLE is true, the user process may modify the page;
- * otherwise, it is read-only.
- * UPAGE must not already be mapped.
- * KPAGE should probably be a page obtained from the user pool
- * with palloc_get_page().
- * Returns true on success, false if UPAGE is already mapped or
- * if memory allocation fails. */
-static bool install_page(void* upage, void* kpage, bool writable)
-{
-    struct thread* t = thread_current();
-
-    /* Verify that there's not already a page at that virtual
-     * address, then map our page there. */
-    return (pml4_get_page(t->pml4, upage) == NULL && pml4_set_page(t->pml4, upage, kpage, writable));
-}
 #else
 /* From here, codes will be used after project 3.
  * If you want to implement the function for only project 2, implement it on the
  * upper block. */
 
-static bool lazy_load_segment(struct page* page, void* aux)
-{
-    /* TODO: Load the segment from the file */
-    /* TODO: This called when the first page fault occurs on address VA. */
-    /* TODO: VA is available when calling this function. */
-
-    if (!vm_claim_page(page->va)) {
-        free(aux);
-        return false; // 프레임 할당 및 매핑 실패
-    } // 수정본
-    struct load_aux* temp = (struct load_aux*)aux;
-    lock_acquire(&filesys_lock);
-    file_seek(thread_current()->execute_file, temp->ofs);
-    if (file_read(thread_current()->execute_file, page->frame->kva, temp->read_bytes) != (int)temp->read_bytes) {
-        lock_release(&filesys_lock);
-        free(aux);
-        return false;
-    }
-    lock_release(&filesys_lock);
-    memset(page->frame->kva + temp->read_bytes, 0, temp->zero_bytes);
-    free(aux); // aux 다씀.
-
-    return true;
-}
-
 /* Loads a segment starting at offset OFS in FILE at address
  * UPAGE.  In total, READ_BYTES + ZERO_BYTES bytes of virtual
  * memory are initialized, as follows:
@@ -813,64 +743,42 @@ static bool lazy_load_segment(struct page* page, void* aux)
  * The pages initialized by this function must be writable by the
  * user process if WRITABLE is true, read-only otherwise.
  *
+ * Nothing is read here: the segment becomes one region, and each
+ * page is loaded when it first faults.
+ *
  * Return true if successful, false if a memory allocation error
- * or disk read error occurs. */
+ * occurs or the segment overlaps another. */
 static bool load_segment(struct file* file, off_t ofs, uint8_t* upage, uint32_t read_bytes, uint32_t zero_bytes,
                          bool writable)
 {
+    struct vm_area* area;
+
     ASSERT((read_bytes + zero_bytes) % PGSIZE == 0);
     ASSERT(pg_ofs(upage) == 0);
     ASSERT(ofs % PGSIZE == 0);
 
-    while (read_bytes > 0 || zero_bytes > 0) {
-        /* Do calculate how to fill this page.
-         * We will read PAGE_READ_BYTES bytes from FILE
-         * and zero the final PAGE_ZERO_BYTES bytes. */
-        size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-        size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-        /* TODO: Set up aux to pass information to the lazy_load_segment. */
-
-        struct load_aux* aux = (struct load_aux*)malloc(sizeof(struct load_aux));
-        aux->ofs = ofs;
-        aux->read_bytes = page_read_bytes;
-        aux->zero_bytes = page_zero_bytes;
-
-        if (!vm_alloc_page_with_initializer(VM_ANON, upage, writable, lazy_load_segment, aux)) {
-            return false;
-        }
-
-        /* Advance. */
-        read_bytes -= page_read_bytes;
-        zero_bytes -= page_zero_bytes;
-        upage += PGSIZE;
-        ofs += page_read_bytes;
-    }
-    return true;
+    /* Read-only pages from the file stay file-backed, so processes
+     * running the same executable share them (see vm/text.c). */
+    area = vma_create(&thread_current()->spt, upage, read_bytes + zero_bytes, VMA_SEGMENT,
+                      !writable && read_bytes > 0 ? VM_FILE : VM_ANON, writable);
+    if (area == NULL)
+        return false;
+    return read_bytes == 0 || vma_set_file(area, file, ofs, read_bytes);
 }
 
 /* Create a PAGE of stack at the USER_STACK. Return true on success. */
 static bool setup_stack(struct intr_frame* if_)
 {
-    bool success = false;
     void* stack_bottom = (void*)(((uint8_t*)USER_STACK) - PGSIZE);
 
-    /* TODO: Map the stack on stack_bottom and claim the page immediately.
-     * TODO: If success, set the rsp accordingly.
-     * TODO: You should mark the page is stack. */
-    /* TODO: Your code goes here */
-
-    success = vm_alloc_page(VM_ANON, stack_bottom, true);
-    if (success == false) {
+    /* The stack is a region that grows down on demand; its first
+     * page is claimed right away for the arguments. */
+    if (vma_create(&thread_current()->spt, stack_bottom, PGSIZE, VMA_STACK, VM_ANON, true) == NULL)
         return false;
-    }
-
-    success = vm_claim_page(stack_bottom);
-    if (success == false) {
+    if (!vm_claim_page(stack_bottom))
         return false;
-    }
     if_->rsp = USER_STACK;
-    return success;
+    return true;
 }
 
 #endif /* VM */
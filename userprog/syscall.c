@@ -16,12 +16,19 @@
 #include <stdbool.h>
 #include <string.h>
 #include <debug.h>
+#ifdef VM
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+#endif
 
 void syscall_entry(void);
 void syscall_handler(struct intr_frame*);
 
 #define CONSOLE_RING_SIZE 1024 /* 콘솔 링버퍼 크기 */
 #define CONSOLE_CHUNK 256      /* 콘솔 flush 시 출력 청크 크기 */
+#ifdef VM
+#define PIN_CHUNK (16 * PGSIZE) /* Bytes of a buffer read() and write() pin at once. */
+#endif
 
 struct lock filesys_lock; /* 파일 시스템 전역 락 */
 static struct lock console_buffer_lock;
@@ -42,6 +49,13 @@ static int write(int fd, const void* buffer, unsigned size);
 static void seek(int fd, unsigned position);
 static unsigned tell(int fd);
 static void close(int fd);
+#ifdef VM
+static void* mmap(void* addr, size_t length, int writable, int fd, off_t offset);
+static int faultstat(struct fault_stat* stat, bool system);
+static int memstat(struct mem_stat* stat);
+static int file_io_pinned(struct file* f, void* buffer, unsigned size, bool read);
+static void copy_out(void* udst, const void* src, size_t size);
+#endif
 static void check_valid_ptr(int count, ...);
 static void check_valid_fd(int fd);
 static void flush_console_buffer(void);
@@ -73,6 +87,26 @@ void syscall_init(void)
     lock_init(&console_buffer_lock);
 }
 
+/* Takes filesys_lock unless the current thread already holds it,
+ * as it does during exec or when a system call faults on a page
+ * that must be read from a file.  Returns what to pass to
+ * filesys_leave(). */
+bool filesys_enter(void)
+{
+    bool held = lock_held_by_current_thread(&filesys_lock);
+
+    if (!held)
+        lock_acquire(&filesys_lock);
+    return held;
+}
+
+/* Undoes filesys_enter(), which returned HELD. */
+void filesys_leave(bool held)
+{
+    if (!held)
+        lock_release(&filesys_lock);
+}
+
 /* The main system call interface */
 void syscall_handler(struct intr_frame* f UNUSED)
 {
@@ -80,7 +114,14 @@ void syscall_handler(struct intr_frame* f UNUSED)
     uint64_t arg1 = f->R.rdi;
     uint64_t arg2 = f->R.rsi;
     uint64_t arg3 = f->R.rdx;
-
+#ifdef VM
+    uint64_t arg4 = f->R.r10;
+    uint64_t arg5 = f->R.r8;
+#endif
+
+#ifdef VM
+    thread_current()->user_rsp = (uint8_t*)f->rsp;
+#endif
     switch (syscall_num) {
     case SYS_HALT:
         halt();
@@ -124,6 +165,29 @@ void syscall_handler(struct intr_frame* f UNUSED)
     case SYS_CLOSE:
         close((int)arg1);
         break;
+#ifdef VM
+    case SYS_MMAP:
+        f->R.rax = (uint64_t)mmap((void*)arg1, (size_t)arg2, (int)arg3, (int)arg4, (off_t)arg5);
+        break;
+    case SYS_MUNMAP:
+        do_munmap((void*)arg1);
+        break;
+    case SYS_MSYNC:
+        f->R.rax = do_msync((void*)arg1, (size_t)arg2);
+        break;
+    case SYS_FAULTSTAT:
+        f->R.rax = faultstat((struct fault_stat*)arg1, (bool)arg2);
+        break;
+    case SYS_MADVISE:
+        f->R.rax = do_madvise((void*)arg1, (size_t)arg2, (int)arg3);
+        break;
+    case SYS_RSSLIMIT:
+        f->R.rax = rss_set_limit((size_t)arg1);
+        break;
+    case SYS_MEMSTAT:
+        f->R.rax = memstat((struct mem_stat*)arg1);
+        break;
+#endif
     default:
         thread_exit();
     }
@@ -280,11 +344,15 @@ static int read(int fd, void* buffer, unsigned size)
     struct thread* t = thread_current();
     struct file* f = t->fdte[fd];
 
+#ifdef VM
+    return file_io_pinned(f, buffer, size, true);
+#else
     lock_acquire(&filesys_lock);
     int byte_read = file_read(f, buffer, size);
     lock_release(&filesys_lock);
 
     return byte_read;
+#endif
 }
 
 static int write(int fd, const void* buffer, unsigned size)
@@ -303,11 +371,15 @@ static int write(int fd, const void* buffer, unsigned size)
     struct thread* curr = thread_current();
     struct file* f = curr->fdte[fd];
 
+#ifdef VM
+    return file_io_pinned(f, (void*)buffer, size, false);
+#else
     lock_acquire(&filesys_lock);
     int bytes_written = file_write(f, buffer, size);
     lock_release(&filesys_lock);
 
     return bytes_written;
+#endif
 }
 
 static void seek(int fd, unsigned position)
@@ -349,6 +421,85 @@ static void close(int fd)
     curr->fdte[fd] = NULL; // remove fdte
 }
 
+#ifdef VM
+/* Maps LENGTH bytes of the file open as FD at ADDR.  Unlike the
+ * other calls, a bad fd (including the console) only fails the
+ * mapping. */
+static void* mmap(void* addr, size_t length, int writable, int fd, off_t offset)
+{
+    struct thread* curr = thread_current();
+
+    if (fd < MIN_FD || fd > MAX_FD || curr->fdte[fd] == NULL)
+        return NULL;
+    return do_mmap(addr, length, writable, curr->fdte[fd], offset);
+}
+
+/* Copies the page-fault statistics of the system, if SYSTEM, or
+ * else of this process, to STAT. */
+static int faultstat(struct fault_stat* stat, bool system)
+{
+    struct fault_stat copy;
+
+    if (!fault_stat_get(&copy, system))
+        return -1;
+    copy_out(stat, &copy, sizeof copy);
+    return 0;
+}
+
+/* Copies SIZE bytes from kernel SRC to user UDST.  All of UDST is
+ * faulted in and pinned writable first, so the copy cannot fault in
+ * kernel mode; if any of it is not writable user memory, the
+ * process is killed. */
+static void copy_out(void* udst, const void* src, size_t size)
+{
+    if (!vm_pin_range(udst, size, true))
+        exit(-1);
+    memcpy(udst, src, size);
+    vm_unpin_range(udst, size);
+}
+
+/* Reads SIZE bytes of F into user BUFFER, if READ, or else writes
+ * them from BUFFER to F, PIN_CHUNK bytes at a time.  Each chunk of
+ * BUFFER is faulted in and pinned before filesys_lock is taken, so
+ * no page fault, with the disk I/O it may need, happens while the
+ * lock is held.  A bad buffer kills the process.  Returns the
+ * number of bytes transferred. */
+static int file_io_pinned(struct file* f, void* buffer, unsigned size, bool read)
+{
+    uint8_t* p = buffer;
+    unsigned done = 0;
+
+    while (done < size) {
+        size_t chunk = PIN_CHUNK - pg_ofs(p + done);
+        off_t n;
+
+        if (chunk > size - done)
+            chunk = size - done;
+        if (!vm_pin_range(p + done, chunk, read))
+            exit(-1);
+        lock_acquire(&filesys_lock);
+        n = read ? file_read(f, p + done, chunk) : file_write(f, p + done, chunk);
+        lock_release(&filesys_lock);
+        vm_unpin_range(p + done, chunk);
+
+        done += n;
+        if ((size_t)n < chunk)
+            break;
+    }
+    return done;
+}
+
+/* Copies the memory use of this process to STAT. */
+static int memstat(struct mem_stat* stat)
+{
+    struct mem_stat copy;
+
+    rss_stat_get(&copy);
+    copy_out(stat, &copy, sizeof copy);
+    return 0;
+}
+#endif
+
 /**
  * Implement user memory access
  * Check allocated-ptr / kernel-memory-ptr / partially-valid-ptr
@@ -381,7 +532,11 @@ static void check_valid_ptr(int count, ...)
         }
 
         // Check memory allocated
+#ifdef VM
+        if (spt_find_page(&thread_current()->spt, ptr) == NULL && vma_find(&thread_current()->spt, ptr) == NULL) {
+#else
         if (pml4_get_page(thread_current()->pml4, ptr) == NULL) {
+#endif
             va_end(ptr_ap);
             exit(-1);
         }
@@ -1,7 +1,20 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
 #include "vm/vm.h"
+#include <bitmap.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
 #include "devices/disk.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+#include "vm/zswap.h"
+
+/* Sectors per swap slot: one page. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
 
 /* DO NOT MODIFY BELOW LINE */
 static struct disk* swap_disk;
@@ -17,20 +30,96 @@ static const struct page_operations anon_ops = {
     .type = VM_ANON,
 };
 
+/* Swap slots in use, one bit per page-sized slot of swap_disk.
+ * Slots are handed out next fit: each search starts where the
+ * previous allocation ended, so pages evicted one after another
+ * land next to each other on disk.
+ *
+ * A copy-on-write page that was shared when it went out stays
+ * shared on disk: every process's page names the same slot, and
+ * SLOT_REFS counts them. */
+static struct bitmap* swap_slots;
+static unsigned* slot_refs;
+static size_t slot_refs_pages; /* Pages backing SLOT_REFS, from vmalloc(). */
+static size_t swap_next;       /* Where the next slot search starts. */
+static struct lock swap_lock;
+
+/* Swap readahead.  A fault that has to read its page from disk
+ * also reads the slots that follow, as long as they hold the pages
+ * that follow in the same process; anon_swap_out_cluster() puts
+ * neighbours there.  The extra pages wait in the swap cache until
+ * they are faulted in, or are dropped, oldest first, to make room.
+ *
+ * The window, counting the faulting page, is sized from the hits
+ * since the last readahead: hits + 2 pages, rounded up to a power
+ * of two and capped at SWAP_RA_MAX.  Without hits it is 1 unless
+ * the fault is next to the previous one, and it shrinks by at most
+ * half per fault. */
+#define SWAP_RA_MAX 16
+#define SWAP_CACHE_MAX (2 * SWAP_RA_MAX)
+
+/* A page read ahead. */
+struct swap_cache_entry {
+    struct list_elem elem; /* In swap_cache, oldest first, or in swap_cache_spare. */
+    size_t slot;           /* Swap slot the page was read from. */
+    void* kva;             /* Its contents, in a kernel page. */
+};
+
+/* Entries come from a static array, so that nothing is allocated
+ * under swap_lock: an allocation may reclaim user frames, and
+ * eviction takes swap_lock after frame_lock. */
+static struct swap_cache_entry swap_cache_entries[SWAP_CACHE_MAX];
+static struct list swap_cache;       /* Protected by swap_lock. */
+static struct list swap_cache_spare; /* Unused entries. */
+static size_t swap_cache_cnt;
+static size_t ra_hits;       /* Swap cache hits since the last readahead. */
+static size_t ra_window = 1; /* Last readahead window. */
+static size_t ra_prev_slot;  /* Slot of the last readahead fault. */
+
+/* Statistics. */
+static long long swap_in_cnt, swap_out_cnt, cluster_cnt;
+static long long ra_cnt, ra_page_cnt, ra_hit_cnt, ra_unused_cnt;
+static size_t slots_used, slots_peak;
+static int64_t io_ticks; /* Timer ticks spent in swap I/O. */
+
+static size_t slot_alloc(size_t cnt);
+static void slot_free(size_t slot);
+static void swap_read(size_t slot, void* kva);
+static void swap_read_ahead(struct page* page, void* kva);
+static void swap_read_disk(size_t slot, void* kvas[], size_t cnt);
+static void swap_write(size_t slot, const void* kva);
+static void swap_write_disk(size_t slot, const void* kva);
+static bool swap_cache_load(size_t slot, void* kva);
+static void swap_cache_drop(struct swap_cache_entry* e);
+
 /* Initialize the data for anonymous pages */
 void vm_anon_init(void)
 {
-    /* TODO: Set up the swap_disk. */
-    swap_disk = NULL;
+    size_t i;
+
+    swap_disk = disk_get(1, 1);
+    lock_init(&swap_lock);
+    list_init(&swap_cache);
+    list_init(&swap_cache_spare);
+    for (i = 0; i < SWAP_CACHE_MAX; i++)
+        list_push_back(&swap_cache_spare, &swap_cache_entries[i].elem);
+    swap_slots = bitmap_create(swap_disk != NULL ? disk_size(swap_disk) / SECTORS_PER_SLOT : 0);
+    if (swap_slots == NULL)
+        PANIC("swap: cannot allocate slot bitmap");
+    slot_refs_pages = DIV_ROUND_UP(bitmap_size(swap_slots) * sizeof *slot_refs, PGSIZE);
+    if (slot_refs_pages > 0)
+        slot_refs = vmalloc(PAL_ASSERT | PAL_ZERO, slot_refs_pages);
+    zswap_init(bitmap_size(swap_slots), swap_write_disk);
 }
 
 /* Initialize the file mapping */
-bool anon_initializer(struct page* page, enum vm_type type, void* kva)
+bool anon_initializer(struct page* page, enum vm_type type UNUSED, void* kva UNUSED)
 {
     /* Set up the handler */
     page->operations = &anon_ops;
 
     struct anon_page* anon_page = &page->anon;
+    anon_page->slot = BITMAP_ERROR;
     return true;
 }
 
@@ -38,17 +127,302 @@ bool anon_initializer(struct page* page, enum vm_type type, void* kva)
 static bool anon_swap_in(struct page* page, void* kva)
 {
     struct anon_page* anon_page = &page->anon;
+
+    if (anon_page->slot == BITMAP_ERROR)
+        return false;
+    if (!swap_cache_load(anon_page->slot, kva) && !zswap_load(anon_page->slot, kva))
+        swap_read_ahead(page, kva);
+
+    lock_acquire(&swap_lock);
+    slot_free(anon_page->slot);
+    swap_in_cnt++;
+    lock_release(&swap_lock);
+    anon_page->slot = BITMAP_ERROR;
     return true;
 }
 
 /* Swap out the page by writing contents to the swap disk. */
 static bool anon_swap_out(struct page* page)
 {
-    struct anon_page* anon_page = &page->anon;
+    return anon_swap_out_cluster(&page, 1);
+}
+
+/* Writes the CNT resident anonymous pages in PAGES to swap.  When
+ * a long enough run of slots is free they go out back to back, as
+ * one sequential write; otherwise each takes the next free slot.
+ * Returns false, with no page swapped out, if swap is full. */
+bool anon_swap_out_cluster(struct page* pages[], size_t cnt)
+{
+    size_t first, i;
+
+    ASSERT(cnt > 0);
+
+    lock_acquire(&swap_lock);
+    first = slot_alloc(cnt);
+    if (first != BITMAP_ERROR) {
+        for (i = 0; i < cnt; i++)
+            pages[i]->anon.slot = first + i;
+        if (cnt > 1)
+            cluster_cnt++;
+    } else {
+        for (i = 0; i < cnt; i++) {
+            pages[i]->anon.slot = slot_alloc(1);
+            if (pages[i]->anon.slot == BITMAP_ERROR) {
+                while (i-- > 0) {
+                    slot_free(pages[i]->anon.slot);
+                    pages[i]->anon.slot = BITMAP_ERROR;
+                }
+                lock_release(&swap_lock);
+                return false;
+            }
+        }
+    }
+    swap_out_cnt += cnt;
+    lock_release(&swap_lock);
+
+    for (i = 0; i < cnt; i++)
+        swap_write(pages[i]->anon.slot, pages[i]->frame->kva);
+    return true;
 }
 
 /* Destroy the anonymous page. PAGE will be freed by the caller. */
 static void anon_destroy(struct page* page)
 {
     struct anon_page* anon_page = &page->anon;
+
+    if (anon_page->slot != BITMAP_ERROR) {
+        lock_acquire(&swap_lock);
+        slot_free(anon_page->slot);
+        lock_release(&swap_lock);
+        anon_page->slot = BITMAP_ERROR;
+    }
+}
+
+/* Copies the contents of PAGE, which is swapped out, into KVA.
+ * PAGE keeps its swap slot. */
+void anon_read_swapped(struct page* page, void* kva)
+{
+    ASSERT(page->anon.slot != BITMAP_ERROR);
+    swap_read(page->anon.slot, kva);
+}
+
+/* Makes anonymous page DST, which has no contents yet, share the
+ * swap slot of SRC, which is swapped out. */
+void anon_swap_dup(struct page* dst, struct page* src)
+{
+    ASSERT(VM_TYPE(dst->operations->type) == VM_ANON);
+    ASSERT(dst->anon.slot == BITMAP_ERROR);
+    ASSERT(src->anon.slot != BITMAP_ERROR);
+
+    lock_acquire(&swap_lock);
+    slot_refs[src->anon.slot]++;
+    lock_release(&swap_lock);
+    dst->anon.slot = src->anon.slot;
+}
+
+/* Prints swap statistics. */
+void swap_print_stats(void)
+{
+    printf("Swap: %lld pages in, %lld pages out (%lld clusters), %zu of %zu slots in use (peak %zu), "
+           "%lld ticks of I/O\n",
+           swap_in_cnt, swap_out_cnt, cluster_cnt, slots_used, bitmap_size(swap_slots), slots_peak, io_ticks);
+    printf("Swap readahead: %lld reads, %lld pages read ahead, %lld hits, %lld unused, window %zu\n", ra_cnt,
+           ra_page_cnt, ra_hit_cnt, ra_unused_cnt, ra_window);
+}
+
+/* Allocates CNT consecutive swap slots, next fit, each with one
+ * reference.  Returns the first, or BITMAP_ERROR if there is no
+ * such run.  Must be called with swap_lock held. */
+static size_t slot_alloc(size_t cnt)
+{
+    size_t slot = bitmap_scan_and_flip(swap_slots, swap_next, cnt, false);
+    size_t i;
+
+    if (slot == BITMAP_ERROR && swap_next > 0)
+        slot = bitmap_scan_and_flip(swap_slots, 0, cnt, false);
+    if (slot == BITMAP_ERROR)
+        return BITMAP_ERROR;
+
+    for (i = 0; i < cnt; i++)
+        slot_refs[slot + i] = 1;
+    swap_next = slot + cnt < bitmap_size(swap_slots) ? slot + cnt : 0;
+    slots_used += cnt;
+    if (slots_used > slots_peak)
+        slots_peak = slots_used;
+    return slot;
+}
+
+/* Drops a reference to SLOT, which is released with the last one.
+ * Must be called with swap_lock held. */
+static void slot_free(size_t slot)
+{
+    struct list_elem* e;
+
+    ASSERT(bitmap_test(swap_slots, slot));
+    ASSERT(slot_refs[slot] > 0);
+    if (--slot_refs[slot] > 0)
+        return;
+    bitmap_reset(swap_slots, slot);
+    slots_used--;
+    zswap_invalidate(slot);
+    for (e = list_begin(&swap_cache); e != list_end(&swap_cache); e = list_next(e)) {
+        struct swap_cache_entry* sce = list_entry(e, struct swap_cache_entry, elem);
+
+        if (sce->slot == slot) {
+            ra_unused_cnt++;
+            swap_cache_drop(sce);
+            break;
+        }
+    }
+}
+
+/* Reads swap slot SLOT into KVA, from the swap cache or the
+ * compressed cache if it is there. */
+static void swap_read(size_t slot, void* kva)
+{
+    if (!swap_cache_load(slot, kva) && !zswap_load(slot, kva))
+        swap_read_disk(slot, &kva, 1);
+}
+
+/* Returns the readahead window for a fault on SLOT, and starts
+ * counting hits anew.  Must be called with swap_lock held. */
+static size_t readahead_window(size_t slot)
+{
+    size_t pages = ra_hits + 2;
+
+    if (pages == 2) {
+        if (slot != ra_prev_slot + 1 && slot + 1 != ra_prev_slot)
+            pages = 1;
+    } else {
+        size_t p = 4;
+
+        while (p < pages)
+            p *= 2;
+        pages = p;
+    }
+    if (pages > SWAP_RA_MAX)
+        pages = SWAP_RA_MAX;
+    if (pages < ra_window / 2)
+        pages = ra_window / 2;
+
+    ra_window = pages;
+    ra_prev_slot = slot;
+    ra_hits = 0;
+    return pages;
+}
+
+/* Reads PAGE, which is on the swap disk, into KVA, together with
+ * the pages that follow it in its process if they are in the slots
+ * that follow on disk.  Those go into the swap cache.  PAGE's owner
+ * is the running thread, so the neighbours cannot be swapped in or
+ * out again behind our back. */
+static void swap_read_ahead(struct page* page, void* kva)
+{
+    size_t slot = page->anon.slot;
+    void* kvas[SWAP_RA_MAX];
+    size_t window, cnt, i;
+
+    lock_acquire(&swap_lock);
+    window = readahead_window(slot);
+    lock_release(&swap_lock);
+
+    kvas[0] = kva;
+    for (cnt = 1; cnt < window && page->owner == thread_current(); cnt++) {
+        struct page* next = spt_find_page(&page->owner->spt, (uint8_t*)page->va + cnt * PGSIZE);
+
+        /* A slot cached in zswap holds nothing on disk yet. */
+        if (next == NULL || VM_TYPE(next->operations->type) != VM_ANON || next->frame != NULL ||
+            next->anon.slot != slot + cnt || zswap_contains(slot + cnt))
+            break;
+        kvas[cnt] = palloc_get_page(0);
+        if (kvas[cnt] == NULL)
+            break;
+    }
+    swap_read_disk(slot, kvas, cnt);
+    if (cnt == 1)
+        return;
+
+    lock_acquire(&swap_lock);
+    ra_cnt++;
+    for (i = 1; i < cnt; i++) {
+        struct swap_cache_entry* e;
+
+        if (swap_cache_cnt == SWAP_CACHE_MAX) {
+            ra_unused_cnt++;
+            swap_cache_drop(list_entry(list_front(&swap_cache), struct swap_cache_entry, elem));
+        }
+        e = list_entry(list_pop_front(&swap_cache_spare), struct swap_cache_entry, elem);
+        e->slot = slot + i;
+        e->kva = kvas[i];
+        list_push_back(&swap_cache, &e->elem);
+        swap_cache_cnt++;
+        ra_page_cnt++;
+    }
+    lock_release(&swap_lock);
+}
+
+/* Copies SLOT's page into KVA and drops it from the swap cache, if
+ * it was read ahead.  Returns true if it was. */
+static bool swap_cache_load(size_t slot, void* kva)
+{
+    struct list_elem* e;
+    bool found = false;
+
+    lock_acquire(&swap_lock);
+    for (e = list_begin(&swap_cache); e != list_end(&swap_cache); e = list_next(e)) {
+        struct swap_cache_entry* sce = list_entry(e, struct swap_cache_entry, elem);
+
+        if (sce->slot == slot) {
+            memcpy(kva, sce->kva, PGSIZE);
+            swap_cache_drop(sce);
+            ra_hits++;
+            ra_hit_cnt++;
+            found = true;
+            break;
+        }
+    }
+    lock_release(&swap_lock);
+    return found;
+}
+
+/* Removes E from the swap cache and frees its page.  Must be
+ * called with swap_lock held. */
+static void swap_cache_drop(struct swap_cache_entry* e)
+{
+    list_remove(&e->elem);
+    swap_cache_cnt--;
+    palloc_free_page(e->kva);
+    list_push_back(&swap_cache_spare, &e->elem);
+}
+
+/* Reads the CNT consecutive swap slots from SLOT into the pages in
+ * KVAS, as one run of sectors. */
+static void swap_read_disk(size_t slot, void* kvas[], size_t cnt)
+{
+    int64_t start = timer_ticks();
+    size_t i;
+
+    for (i = 0; i < cnt * SECTORS_PER_SLOT; i++)
+        disk_read(swap_disk, slot * SECTORS_PER_SLOT + i,
+                  (uint8_t*)kvas[i / SECTORS_PER_SLOT] + i % SECTORS_PER_SLOT * DISK_SECTOR_SIZE);
+    io_ticks += timer_elapsed(start);
+}
+
+/* Writes the page at KVA to swap slot SLOT: into the compressed
+ * cache if it takes the page, otherwise to disk. */
+static void swap_write(size_t slot, const void* kva)
+{
+    if (!zswap_store(slot, kva))
+        swap_write_disk(slot, kva);
+}
+
+/* Writes the page at KVA to SLOT on the swap disk. */
+static void swap_write_disk(size_t slot, const void* kva)
+{
+    int64_t start = timer_ticks();
+    size_t i;
+
+    for (i = 0; i < SECTORS_PER_SLOT; i++)
+        disk_write(swap_disk, slot * SECTORS_PER_SLOT + i, (const uint8_t*)kva + i * DISK_SECTOR_SIZE);
+    io_ticks += timer_elapsed(start);
 }
@@ -0,0 +1,134 @@
+/* fault.c: Page-fault statistics.
+ *
+ * vm_try_handle_fault() times every fault with the time-stamp
+ * counter and reports it here with its class.  The disk driver
+ * keeps a running total of the cycles each thread spends waiting
+ * for it, so the part of a fault spent on I/O is the growth of
+ * that total across the fault; the rest is CPU.  Each process has
+ * its own counts and histograms, and so does the system as a
+ * whole. */
+
+#include "vm/fault.h"
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+static struct fault_stat system_stat;
+
+static const char* class_names[FAULT_CLASS_CNT] = {"minor", "major", "zero-fill", "cow", "stack", "invalid"};
+
+/* Gives T, a new process, statistics of its own.  Without memory
+ * for them, its faults only count system-wide. */
+void fault_stat_init(struct thread* t)
+{
+    if (t->fault_stat == NULL)
+        t->fault_stat = calloc(1, sizeof *t->fault_stat);
+}
+
+/* Frees the statistics of T, a process that exits. */
+void fault_stat_exit(struct thread* t)
+{
+    free(t->fault_stat);
+    t->fault_stat = NULL;
+}
+
+/* Returns the histogram bucket for CYCLES. */
+static size_t hist_bucket(uint64_t cycles)
+{
+    size_t b = 0;
+
+    for (cycles >>= FAULT_HIST_SHIFT + 1; cycles > 0 && b < FAULT_HIST_BUCKETS - 1; cycles >>= 1)
+        b++;
+    return b;
+}
+
+static void class_add(struct fault_class_stat* s, uint64_t cpu, uint64_t io)
+{
+    s->cnt++;
+    s->cpu_cycles += cpu;
+    s->io_cycles += io;
+    s->cpu_hist[hist_bucket(cpu)]++;
+    s->io_hist[hist_bucket(io)]++;
+}
+
+/* Records a fault of CLASS in the current process that took CYCLES
+ * in all, IO_CYCLES of them waiting for the disk.  FILESYS_LOCKED
+ * says the process held filesys_lock when it faulted, which
+ * read() and write() pin their buffers to avoid. */
+void fault_account(enum fault_class class, uint64_t cycles, uint64_t io_cycles, bool filesys_locked)
+{
+    struct thread* t = thread_current();
+    uint64_t cpu = cycles > io_cycles ? cycles - io_cycles : 0;
+    enum intr_level old_level;
+
+    ASSERT(class < FAULT_CLASS_CNT);
+
+    /* Only the process itself updates its own numbers. */
+    if (t->fault_stat != NULL) {
+        class_add(&t->fault_stat->classes[class], cpu, io_cycles);
+        if (filesys_locked)
+            t->fault_stat->filesys_locked_cnt++;
+    }
+
+    old_level = intr_disable();
+    class_add(&system_stat.classes[class], cpu, io_cycles);
+    if (filesys_locked)
+        system_stat.filesys_locked_cnt++;
+    intr_set_level(old_level);
+}
+
+/* Copies the statistics of the system, if SYSTEM, or else of the
+ * current process, into DST.  Returns false if the process has
+ * none. */
+bool fault_stat_get(struct fault_stat* dst, bool system)
+{
+    struct thread* t = thread_current();
+    enum intr_level old_level;
+
+    if (!system) {
+        if (t->fault_stat == NULL)
+            return false;
+        *dst = *t->fault_stat;
+        return true;
+    }
+    old_level = intr_disable();
+    *dst = system_stat;
+    intr_set_level(old_level);
+    return true;
+}
+
+/* Prints one histogram, as counts from the shortest bucket up. */
+static void print_hist(const char* what, const uint32_t hist[])
+{
+    size_t b;
+
+    printf("  %s:", what);
+    for (b = 0; b < FAULT_HIST_BUCKETS; b++)
+        printf(" %u", hist[b]);
+    printf("\n");
+}
+
+/* Prints system-wide page-fault statistics. */
+void fault_print_stats(void)
+{
+    int c;
+
+    printf("Page faults:");
+    for (c = 0; c < FAULT_CLASS_CNT; c++)
+        printf(" %llu %s%s", system_stat.classes[c].cnt, class_names[c], c + 1 < FAULT_CLASS_CNT ? "," : "\n");
+    if (system_stat.filesys_locked_cnt > 0)
+        printf("Faults under filesys_lock: %llu\n", system_stat.filesys_locked_cnt);
+
+    for (c = 0; c < FAULT_CLASS_CNT; c++) {
+        const struct fault_class_stat* s = &system_stat.classes[c];
+
+        if (s->cnt == 0)
+            continue;
+        printf("Faults %s: %llu cpu + %llu io cycles on average (bucket 0: under 2^%d)\n", class_names[c],
+               s->cpu_cycles / s->cnt, s->io_cycles / s->cnt, FAULT_HIST_SHIFT + 1);
+        print_hist("cpu", s->cpu_hist);
+        print_hist("io ", s->io_hist);
+    }
+}
@@ -1,10 +1,21 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <round.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/mmu.h"
+#include "threads/thread.h"
+#include "userprog/syscall.h"
+
+/* How often the flusher writes dirty mapped pages back. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
 
 static bool file_backed_swap_in(struct page* page, void* kva);
 static bool file_backed_swap_out(struct page* page);
 static void file_backed_destroy(struct page* page);
+static void write_back(struct page* page);
+static void flusher(void* aux);
 
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
@@ -14,45 +25,184 @@ static const struct page_operations file_ops = {
     .type = VM_FILE,
 };
 
+/* Set once the flusher thread runs. */
+static bool flusher_started;
+
 /* The initializer of file vm */
 void vm_file_init(void)
 {
 }
 
 /* Initialize the file backed page */
-bool file_backed_initializer(struct page* page, enum vm_type type, void* kva)
+bool file_backed_initializer(struct page* page, enum vm_type type UNUSED, void* kva)
 {
     /* Set up the handler */
     page->operations = &file_ops;
 
     struct file_page* file_page = &page->file;
-    return true;
+    struct vm_area* area = vma_find(&page->owner->spt, page->va);
+    size_t ofs;
+
+    if (area == NULL || area->file == NULL)
+        return false;
+    ofs = (uint8_t*)page->va - area->start;
+    file_page->file = area->file;
+    file_page->offset = area->offset + ofs;
+    file_page->read_bytes = 0;
+    if (ofs < area->read_bytes)
+        file_page->read_bytes = area->read_bytes - ofs < PGSIZE ? area->read_bytes - ofs : PGSIZE;
+
+    /* Without a frame, the page is only being typed; its contents
+     * are read on the next swap_in(). */
+    return kva == NULL || file_backed_swap_in(page, kva);
 }
 
 /* Swap in the page by read contents from the file. */
 static bool file_backed_swap_in(struct page* page, void* kva)
 {
-    struct file_page* file_page UNUSED = &page->file;
+    struct file_page* file_page = &page->file;
+    bool held = filesys_enter();
+    off_t read = file_read_at(file_page->file, kva, file_page->read_bytes, file_page->offset);
+
+    filesys_leave(held);
+    if (read != (off_t)file_page->read_bytes)
+        return false;
+    memset((uint8_t*)kva + file_page->read_bytes, 0, PGSIZE - file_page->read_bytes);
+    return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  Clean
+ * pages are simply dropped; they read back from the file.
+ *
+ * The evictor holds frame_lock, which must never wait for
+ * filesys_lock: a process that holds filesys_lock may be faulting
+ * and waiting for frame_lock.  A dirty page whose file is busy is
+ * therefore refused, and the evictor picks another victim. */
 static bool file_backed_swap_out(struct page* page)
 {
-    struct file_page* file_page UNUSED = &page->file;
+    bool held = lock_held_by_current_thread(&filesys_lock);
+
+    if (!pml4_is_dirty(page->owner->pml4, page->va))
+        return true;
+    if (!held && !lock_try_acquire(&filesys_lock))
+        return false;
+    write_back(page);
+    filesys_leave(held);
+    return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
-static void file_backed_destroy(struct page* page)
+static void file_backed_destroy(struct page* page UNUSED)
+{
+    /* Whoever removes file-backed pages flushes them first with
+     * vm_flush_range(), which takes the locks in the right order. */
+}
+
+/* Writes resident PAGE back to its file if the process modified
+ * it, and marks it clean.  Must be called with filesys_lock and
+ * frame_lock held. */
+void file_page_flush(struct page* page)
 {
-    struct file_page* file_page UNUSED = &page->file;
+    ASSERT(VM_TYPE(page->operations->type) == VM_FILE);
+
+    if (page->frame != NULL && pml4_is_dirty(page->owner->pml4, page->va))
+        write_back(page);
+}
+
+/* Writes PAGE to its file.  The dirty bit is cleared first, so a
+ * store that races with the write marks the page dirty again. */
+static void write_back(struct page* page)
+{
+    struct file_page* file_page = &page->file;
+
+    pml4_set_dirty(page->owner->pml4, page->va, false);
+    file_write_at(file_page->file, page->frame->kva, file_page->read_bytes, file_page->offset);
 }
 
 /* Do the mmap */
 void* do_mmap(void* addr, size_t length, int writable, struct file* file, off_t offset)
 {
+    struct supplemental_page_table* spt = &thread_current()->spt;
+    struct vm_area* area;
+    size_t read_bytes = 0;
+    off_t file_len;
+    bool held;
+
+    if (addr == NULL || pg_ofs(addr) != 0 || length == 0 || offset < 0 || offset % PGSIZE != 0)
+        return NULL;
+
+    held = filesys_enter();
+    file_len = file_length(file);
+    filesys_leave(held);
+    if (file_len == 0)
+        return NULL;
+    if (offset < file_len)
+        read_bytes = (size_t)(file_len - offset) < length ? (size_t)(file_len - offset) : length;
+
+    /* vma_create() refuses kernel addresses, wrap-around and any
+     * overlap with code, data, the stack or another mapping. */
+    area = vma_create(spt, addr, length, VMA_MMAP, VM_FILE, writable);
+    if (area == NULL)
+        return NULL;
+    if (!vma_set_file(area, file, offset, read_bytes)) {
+        vma_destroy(spt, area);
+        return NULL;
+    }
+
+    if (!flusher_started) {
+        flusher_started = true;
+        thread_create("flusher", PRI_DEFAULT, flusher, NULL);
+    }
+    return addr;
 }
 
 /* Do the munmap */
 void do_munmap(void* addr)
 {
+    struct supplemental_page_table* spt = &thread_current()->spt;
+    struct vm_area* area = vma_find(spt, addr);
+
+    if (area == NULL || area->kind != VMA_MMAP || area->start != addr)
+        return;
+    vm_flush_range(spt, area->start, area->end);
+    vm_remove_range(spt, area->start, area->end);
+    vma_destroy(spt, area);
+}
+
+/* Writes back the dirty pages of every mapping that overlaps the
+ * LENGTH bytes at ADDR.  Returns 0 on success, or -1 if ADDR is not
+ * page-aligned or no mapping overlaps the range. */
+int do_msync(void* addr, size_t length)
+{
+    struct supplemental_page_table* spt = &thread_current()->spt;
+    uint8_t* start = addr;
+    uint8_t* end = start + ROUND_UP(length, PGSIZE);
+    struct list_elem* e;
+    int result = -1;
+
+    if (pg_ofs(addr) != 0 || end < start)
+        return -1;
+
+    for (e = list_begin(&spt->areas); e != list_end(&spt->areas); e = list_next(e)) {
+        struct vm_area* a = list_entry(e, struct vm_area, elem);
+
+        if (a->kind != VMA_MMAP || a->end <= start || a->start >= end)
+            continue;
+        vm_flush_range(spt, a->start > start ? a->start : start, a->end < end ? a->end : end);
+        result = 0;
+    }
+    return result;
+}
+
+/* Background flusher.  Every FLUSH_INTERVAL it writes dirty
+ * mapped pages back, so that munmap and exit find little left to
+ * write, and data reaches the disk even while a process keeps a
+ * file mapped. */
+static void flusher(void* aux UNUSED)
+{
+    for (;;) {
+        timer_sleep(FLUSH_INTERVAL);
+        while (vm_flush_frames() > 0)
+            continue;
+    }
 }
@@ -0,0 +1,131 @@
+/* ksm.c: Samepage merging.
+ *
+ * Forked workers often end up holding many anonymous pages with
+ * the same contents, each in a frame of its own.  The "ksm" thread
+ * walks the frame table a few frames at a time, at the lowest
+ * priority, and merges such frames: every page of one is moved
+ * onto the other, read-only, and the first frame is freed.  A
+ * write to a merged page then faults and gets a private copy, as
+ * after fork.  See vm_ksm_scan() for the walk.
+ *
+ * A frame is considered only once its checksum is the same on two
+ * passes in a row, so pages that are still being written are left
+ * alone.  It is then looked up here by checksum.  If there is no
+ * frame with that checksum, it is entered in the table and waits
+ * for a twin; if there is, the two are compared byte for byte
+ * before anything is merged, so stale entries do no harm.  Pages
+ * of zeros are merged with the zero frame instead.
+ *
+ * The scan rate is given in pages per second with -ksm=PAGES; the
+ * thread is not started without it.  Everything here but the
+ * thread itself is called with frame_lock held. */
+
+#include "vm/ksm.h"
+#include <hash.h>
+#include <round.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/thread.h"
+#include "vm/vm.h"
+
+/* Ticks between two batches of the scan. */
+#define KSM_PERIOD (TIMER_FREQ / 10)
+
+static size_t pages_per_sec;
+static struct hash ksm_frames;
+
+/* Statistics. */
+static long long scan_cnt, merge_cnt;
+
+static void ksm_thread(void* aux);
+
+static uint64_t ksm_hash(const struct hash_elem* e, void* aux UNUSED)
+{
+    return hash_int(hash_entry(e, struct frame, ksm_elem)->ksm_sum);
+}
+
+static bool ksm_less(const struct hash_elem* a, const struct hash_elem* b, void* aux UNUSED)
+{
+    return hash_entry(a, struct frame, ksm_elem)->ksm_sum < hash_entry(b, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Scans RATE pages per second; 0 turns merging off. */
+void ksm_set_rate(size_t rate)
+{
+    pages_per_sec = rate;
+}
+
+void ksm_init(void)
+{
+    if (!hash_init(&ksm_frames, ksm_hash, ksm_less, NULL))
+        PANIC("ksm: cannot allocate table");
+    if (pages_per_sec > 0)
+        thread_create("ksm", PRI_MIN, ksm_thread, NULL);
+}
+
+/* Returns the frame entered with checksum SUM, or a null pointer. */
+struct frame* ksm_lookup(unsigned sum)
+{
+    struct frame key;
+    struct hash_elem* e;
+
+    key.ksm_sum = sum;
+    e = hash_find(&ksm_frames, &key.ksm_elem);
+    return e != NULL ? hash_entry(e, struct frame, ksm_elem) : NULL;
+}
+
+/* Enters FRAME under its checksum, unless another frame has that
+ * checksum already. */
+void ksm_insert(struct frame* frame)
+{
+    ASSERT(!frame->ksm_listed);
+
+    frame->ksm_listed = hash_insert(&ksm_frames, &frame->ksm_elem) == NULL;
+}
+
+/* Removes FRAME from the table, if it is there. */
+void ksm_remove(struct frame* frame)
+{
+    if (frame->ksm_listed) {
+        hash_delete(&ksm_frames, &frame->ksm_elem);
+        frame->ksm_listed = false;
+    }
+}
+
+/* Prints merging statistics: frames scanned, frames freed by
+ * merging, and the frames in the table that more than one page
+ * shares. */
+void ksm_print_stats(void)
+{
+    struct hash_iterator i;
+    size_t shared = 0, sharing = 0;
+
+    if (pages_per_sec == 0)
+        return;
+    hash_first(&i, &ksm_frames);
+    while (hash_next(&i)) {
+        struct frame* frame = hash_entry(hash_cur(&i), struct frame, ksm_elem);
+
+        if (frame->ref_cnt > 1) {
+            shared++;
+            sharing += frame->ref_cnt;
+        }
+    }
+    printf("KSM: %zu pages/s, %lld pages scanned, %lld merged, %zu frames shared by %zu pages\n", pages_per_sec,
+           scan_cnt, merge_cnt, shared, sharing);
+}
+
+/* Scans a batch every KSM_PERIOD.  At PRI_MIN, it only ever runs
+ * when nothing else wants the CPU. */
+static void ksm_thread(void* aux UNUSED)
+{
+    size_t batch = DIV_ROUND_UP(pages_per_sec * KSM_PERIOD, TIMER_FREQ);
+
+    for (;;) {
+        size_t merged;
+
+        timer_sleep(KSM_PERIOD);
+        scan_cnt += vm_ksm_scan(batch, &merged);
+        merge_cnt += merged;
+    }
+}
@@ -0,0 +1,103 @@
+/* kswapd.c: Page-out daemon.
+ *
+ * Left alone, a fault that finds no free frame has to evict one
+ * itself, and waits for the swap or file write that takes.  The
+ * kswapd thread does that work ahead of time instead.  Whenever a
+ * frame is allocated and the free frames drop below the low
+ * watermark, it is woken; it evicts pages until they are back at
+ * the high watermark, then writes back a batch of dirty
+ * file-backed pages so that the next victims can be dropped
+ * without I/O.  Faults then mostly find a free or clean frame.
+ *
+ * The watermarks default to a fraction of the user pool and can be
+ * set at boot with -wm=LOW,HIGH.  A low watermark of 0 keeps the
+ * daemon asleep. */
+
+#include "vm/kswapd.h"
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+/* Default low watermark, as a fraction of the user pool, and its
+ * floor in pages.  The high watermark is twice the low one. */
+#define WMARK_DIV 64
+#define WMARK_MIN 8
+
+static size_t wmark_low, wmark_high;
+static bool wmark_set; /* Given on the command line. */
+
+static struct semaphore kswapd_sema;
+static bool kswapd_started;
+static bool kswapd_awake; /* Woken and not yet done. */
+
+/* Statistics. */
+static long long wakeup_cnt, evict_cnt, clean_cnt, direct_cnt;
+
+static void kswapd(void* aux);
+
+/* Sets the watermarks to LOW and HIGH pages.  Returns false if LOW
+ * is above HIGH. */
+bool kswapd_set_watermarks(size_t low, size_t high)
+{
+    if (low > high)
+        return false;
+    wmark_low = low;
+    wmark_high = high;
+    wmark_set = true;
+    return true;
+}
+
+/* Picks default watermarks, unless they were set, and starts the
+ * daemon. */
+void kswapd_init(void)
+{
+    if (!wmark_set) {
+        size_t pages = palloc_pool_pages(PAL_USER);
+
+        wmark_low = pages / WMARK_DIV > WMARK_MIN ? pages / WMARK_DIV : WMARK_MIN;
+        wmark_high = wmark_low * 2;
+    }
+    sema_init(&kswapd_sema, 0);
+    kswapd_started = thread_create("kswapd", PRI_DEFAULT, kswapd, NULL) != TID_ERROR;
+}
+
+/* Called after each frame allocation, with frame_lock held.
+ * DIRECT is true if the allocating thread had to evict a page
+ * itself.  Wakes the daemon if free pages are below the low
+ * watermark. */
+void kswapd_poke(bool direct)
+{
+    if (direct)
+        direct_cnt++;
+    if (!kswapd_started || kswapd_awake || vm_free_frame_cnt() >= wmark_low)
+        return;
+    kswapd_awake = true;
+    sema_up(&kswapd_sema);
+}
+
+/* Returns true if fewer frames than the low watermark are free. */
+bool kswapd_below_low(void)
+{
+    return vm_free_frame_cnt() < wmark_low;
+}
+
+/* Prints the watermarks and what the daemon did. */
+void kswapd_print_stats(void)
+{
+    printf("Kswapd: watermarks %zu/%zu pages, %lld wakeups, %lld pages evicted, %lld cleaned, %lld direct evictions\n",
+           wmark_low, wmark_high, wakeup_cnt, evict_cnt, clean_cnt, direct_cnt);
+}
+
+static void kswapd(void* aux UNUSED)
+{
+    for (;;) {
+        sema_down(&kswapd_sema);
+        wakeup_cnt++;
+        evict_cnt += vm_reclaim_frames(wmark_high);
+        clean_cnt += vm_flush_frames();
+        kswapd_awake = false;
+    }
+}
@@ -0,0 +1,381 @@
+/* replace.c: Page replacement policies.
+ *
+ * The evictor asks the policy chosen at boot with -vmp=NAME which
+ * frame to evict next:
+ *
+ *   clock  Second chance over all frames in use.
+ *
+ *   2q     Full 2Q, which approximates LRU-2.  A page is first put
+ *          on A1in, a FIFO.  If it is evicted from there and faults
+ *          again while A1out still remembers it, it was used twice
+ *          and goes to Am, which is managed as a clock.  A single
+ *          scan never reaches Am.
+ *
+ *   arc    ARC, in the form of CAR (Bansal and Modha, FAST '04):
+ *          T1 holds pages used once recently and T2 pages used
+ *          more often, each managed as a clock, and the ghost lists
+ *          B1 and B2 remember pages recently evicted from each.  A
+ *          fault on a ghost moves the target size P of T1 towards
+ *          the list that would have kept the page.
+ *
+ * None of them sees individual accesses.  They sample the accessed
+ * bits of a frame's pages when they meet it while looking for a
+ * victim, and clear them.  Right after a fault the bit only shows
+ * that fault, so the first sample of a frame in 2Q and ARC just
+ * clears it.
+ *
+ * Ghost lists hold struct page, which outlives its frame while the
+ * page is in swap or in its file.  Everything here is called with
+ * frame_lock held. */
+
+#include "vm/replace.h"
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/vm.h"
+
+/* A list of frames or of ghost pages, with its length. */
+struct lru {
+    struct list list;
+    size_t cnt;
+};
+
+struct replace_policy {
+    const char* name;
+    void (*add)(struct frame*);
+    void (*evict)(struct frame*, struct page*);
+    struct frame* (*victim)(void);
+};
+
+static struct lru lrus[LRU_CNT];
+static struct lru ghosts[GHOST_CNT];
+static size_t capacity; /* Number of frames. */
+
+/* Statistics. */
+static long long victim_cnt, ghost_hit_cnt, deactivate_cnt;
+
+static void clock_add(struct frame*);
+static struct frame* clock_victim(void);
+static void twoq_add(struct frame*);
+static void twoq_evict(struct frame*, struct page*);
+static struct frame* twoq_victim(void);
+static void arc_add(struct frame*);
+static void arc_evict(struct frame*, struct page*);
+static struct frame* arc_victim(void);
+
+static const struct replace_policy policies[] = {
+    {"clock", clock_add, NULL, clock_victim},
+    {"2q", twoq_add, twoq_evict, twoq_victim},
+    {"arc", arc_add, arc_evict, arc_victim},
+};
+
+static const struct replace_policy* policy = &policies[0];
+
+/* Makes NAME the replacement policy.  Returns false if there is no
+ * such policy. */
+bool replace_select(const char* name)
+{
+    size_t i;
+
+    for (i = 0; i < sizeof policies / sizeof *policies; i++)
+        if (!strcmp(name, policies[i].name)) {
+            policy = &policies[i];
+            return true;
+        }
+    return false;
+}
+
+/* Sets up the policy for FRAME_CNT frames. */
+void replace_init(size_t frame_cnt)
+{
+    int i;
+
+    for (i = 0; i < LRU_CNT; i++)
+        list_init(&lrus[i].list);
+    for (i = 0; i < GHOST_CNT; i++)
+        list_init(&ghosts[i].list);
+    capacity = frame_cnt > 0 ? frame_cnt : 1;
+}
+
+/* Frame lists. */
+
+static void lru_push(struct frame* frame, enum lru_list which)
+{
+    list_push_back(&lrus[which].list, &frame->lru_elem);
+    lrus[which].cnt++;
+    frame->lru_list = which;
+}
+
+static void lru_pop(struct frame* frame)
+{
+    list_remove(&frame->lru_elem);
+    lrus[frame->lru_list].cnt--;
+    frame->lru_list = LRU_NONE;
+}
+
+/* Moves FRAME to the back of list WHICH. */
+static void lru_move(struct frame* frame, enum lru_list which)
+{
+    lru_pop(frame);
+    lru_push(frame, which);
+}
+
+static struct frame* lru_front(enum lru_list which)
+{
+    return list_entry(list_front(&lrus[which].list), struct frame, lru_elem);
+}
+
+/* Ghost lists. */
+
+static void ghost_pop(struct page* page)
+{
+    list_remove(&page->ghost_elem);
+    ghosts[page->ghost].cnt--;
+    page->ghost = GHOST_NONE;
+}
+
+/* Remembers PAGE on list WHICH, forgetting the oldest pages there
+ * beyond LIMIT. */
+static void ghost_push(struct page* page, enum ghost_list which, size_t limit)
+{
+    if (page->ghost != GHOST_NONE)
+        ghost_pop(page);
+    list_push_back(&ghosts[which].list, &page->ghost_elem);
+    ghosts[which].cnt++;
+    page->ghost = which;
+    while (ghosts[which].cnt > limit)
+        ghost_pop(list_entry(list_front(&ghosts[which].list), struct page, ghost_elem));
+}
+
+/* Forgets the oldest page on list WHICH, if any. */
+static void ghost_drop_oldest(enum ghost_list which)
+{
+    if (!list_empty(&ghosts[which].list))
+        ghost_pop(list_entry(list_front(&ghosts[which].list), struct page, ghost_elem));
+}
+
+/* Policy interface. */
+
+/* Hands FRAME, just filled and mapped, to the policy. */
+void replace_add(struct frame* frame)
+{
+    ASSERT(frame->lru_list == LRU_NONE);
+    ASSERT(frame->rmap != NULL);
+
+    frame->lru_fresh = true;
+    policy->add(frame);
+}
+
+/* Takes FRAME away from the policy, if it has it.  If EVICTED, the
+ * frame's pages are being written out and the policy may remember
+ * them; otherwise they are going away. */
+void replace_remove(struct frame* frame, bool evicted)
+{
+    if (frame->lru_list == LRU_NONE)
+        return;
+    if (evicted && policy->evict != NULL)
+        policy->evict(frame, frame->rmap);
+    lru_pop(frame);
+}
+
+/* Puts FRAME, which the evictor could not write out, behind the
+ * other frames on its list, so that the next search moves on. */
+void replace_skip(struct frame* frame)
+{
+    if (frame->lru_list != LRU_NONE)
+        lru_move(frame, frame->lru_list);
+}
+
+/* Returns the frame to evict next, or a null pointer if every
+ * frame is pinned.  The frame stays with the policy until
+ * replace_remove(). */
+struct frame* replace_victim(void)
+{
+    struct frame* frame = policy->victim();
+
+    if (frame != NULL)
+        victim_cnt++;
+    return frame;
+}
+
+/* Puts FRAME, whose pages will not be used again soon, where the
+ * policy looks for its next victim, and takes away the benefit of
+ * its first sample.  The caller clears the accessed bits. */
+void replace_deactivate(struct frame* frame)
+{
+    if (frame->lru_list == LRU_NONE)
+        return;
+    list_remove(&frame->lru_elem);
+    list_push_front(&lrus[frame->lru_list].list, &frame->lru_elem);
+    frame->lru_fresh = false;
+    deactivate_cnt++;
+}
+
+/* Forgets PAGE, which is being destroyed. */
+void replace_forget(struct page* page)
+{
+    if (page->ghost != GHOST_NONE)
+        ghost_pop(page);
+}
+
+void replace_print_stats(void)
+{
+    printf("Replacement: %s policy, %lld victims, %lld ghost hits, %lld deactivated\n", policy->name, victim_cnt,
+           ghost_hit_cnt, deactivate_cnt);
+}
+
+/* Clock. */
+
+static void clock_add(struct frame* frame)
+{
+    /* The hand is at the front: a new frame is the last it reaches. */
+    lru_push(frame, LRU_CLOCK);
+}
+
+static struct frame* clock_victim(void)
+{
+    size_t i, n = lrus[LRU_CLOCK].cnt;
+
+    for (i = 0; i < 2 * n; i++) {
+        struct frame* frame = lru_front(LRU_CLOCK);
+
+        lru_move(frame, LRU_CLOCK);
+        if (!frame->pinned && !frame_accessed(frame, true))
+            return frame;
+    }
+    return NULL;
+}
+
+/* Runs the clock over list WHICH and returns the first unpinned
+ * frame that was not used since the hand last passed it.  Frames
+ * that were used go to the back of list TO.  Gives up, returning a
+ * null pointer, after MAX frames. */
+static struct frame* lru_sweep(enum lru_list which, enum lru_list to, size_t max)
+{
+    while (max-- > 0 && !list_empty(&lrus[which].list)) {
+        struct frame* frame = lru_front(which);
+
+        if (frame->pinned)
+            lru_move(frame, which);
+        else if (frame->lru_fresh) {
+            frame->lru_fresh = false;
+            frame_accessed(frame, true);
+            lru_move(frame, which);
+        } else if (frame_accessed(frame, true))
+            lru_move(frame, to);
+        else
+            return frame;
+    }
+    return NULL;
+}
+
+/* 2Q, with the sizes of A1in and A1out the paper recommends. */
+
+#define TWOQ_KIN (capacity / 4 > 0 ? capacity / 4 : 1)
+#define TWOQ_KOUT (capacity / 2 > 0 ? capacity / 2 : 1)
+
+static void twoq_add(struct frame* frame)
+{
+    struct page* page = frame->rmap;
+
+    if (page->ghost == GHOST_A1OUT) {
+        ghost_hit_cnt++;
+        ghost_pop(page);
+        lru_push(frame, LRU_AM);
+    } else
+        lru_push(frame, LRU_A1IN);
+}
+
+static void twoq_evict(struct frame* frame, struct page* page)
+{
+    if (frame->lru_list == LRU_A1IN)
+        ghost_push(page, GHOST_A1OUT, TWOQ_KOUT);
+}
+
+/* Returns the oldest unpinned frame on A1in, or a null pointer. */
+static struct frame* a1in_oldest(void)
+{
+    struct list_elem* e;
+
+    for (e = list_begin(&lrus[LRU_A1IN].list); e != list_end(&lrus[LRU_A1IN].list); e = list_next(e)) {
+        struct frame* frame = list_entry(e, struct frame, lru_elem);
+
+        if (!frame->pinned)
+            return frame;
+    }
+    return NULL;
+}
+
+static struct frame* twoq_victim(void)
+{
+    struct frame* frame = NULL;
+
+    if (lrus[LRU_A1IN].cnt > TWOQ_KIN)
+        frame = a1in_oldest();
+    if (frame == NULL)
+        frame = lru_sweep(LRU_AM, LRU_AM, 3 * lrus[LRU_AM].cnt);
+    if (frame == NULL)
+        frame = a1in_oldest();
+    return frame;
+}
+
+/* ARC, as CAR. */
+
+static size_t arc_p; /* Target size of T1. */
+
+static void arc_add(struct frame* frame)
+{
+    struct page* page = frame->rmap;
+    size_t b1 = ghosts[GHOST_B1].cnt, b2 = ghosts[GHOST_B2].cnt;
+
+    if (page->ghost == GHOST_B1) {
+        /* T1 was too small to keep this page: grow its target. */
+        size_t delta = b2 > b1 ? b2 / b1 : 1;
+
+        ghost_hit_cnt++;
+        arc_p = arc_p + delta < capacity ? arc_p + delta : capacity;
+        ghost_pop(page);
+        lru_push(frame, LRU_T2);
+    } else if (page->ghost == GHOST_B2) {
+        size_t delta = b1 > b2 ? b1 / b2 : 1;
+
+        ghost_hit_cnt++;
+        arc_p = arc_p > delta ? arc_p - delta : 0;
+        ghost_pop(page);
+        lru_push(frame, LRU_T2);
+    } else {
+        /* Keep the history within twice the number of frames. */
+        if (lrus[LRU_T1].cnt + b1 >= capacity)
+            ghost_drop_oldest(GHOST_B1);
+        else if (lrus[LRU_T1].cnt + lrus[LRU_T2].cnt + b1 + b2 >= 2 * capacity)
+            ghost_drop_oldest(GHOST_B2);
+        lru_push(frame, LRU_T1);
+    }
+}
+
+static void arc_evict(struct frame* frame, struct page* page)
+{
+    ghost_push(page, frame->lru_list == LRU_T1 ? GHOST_B1 : GHOST_B2, capacity);
+}
+
+static struct frame* arc_victim(void)
+{
+    size_t tries = 3 * (lrus[LRU_T1].cnt + lrus[LRU_T2].cnt);
+    size_t t1_target = arc_p > 1 ? arc_p : 1;
+
+    while (tries-- > 0) {
+        struct frame* frame;
+
+        /* Take from T1 while it is over its target; a used page
+         * there moves on to T2. */
+        if (lrus[LRU_T1].cnt >= t1_target || list_empty(&lrus[LRU_T2].list))
+            frame = lru_sweep(LRU_T1, LRU_T2, 1);
+        else
+            frame = lru_sweep(LRU_T2, LRU_T2, 1);
+        if (frame != NULL)
+            return frame;
+        if (list_empty(&lrus[LRU_T1].list) && list_empty(&lrus[LRU_T2].list))
+            break;
+    }
+    return NULL;
+}
@@ -0,0 +1,118 @@
+/* rss.c: Resident-set limits and working-set estimation.
+ *
+ * Each process counts the pages it holds in frames, its resident
+ * set size (RSS).  A frame shared with other processes counts for
+ * each of them; the zero frame counts for none.  rsslimit() gives
+ * the running process a limit, which survives exec and is
+ * inherited by fork, so a parent can limit a child before it runs
+ * its program.  A process at its limit gets no new frames: it
+ * replaces one of its own pages instead, chosen by
+ * vm_evict_own(), and leaves other processes' frames alone.
+ *
+ * With -ws=TICKS, the working set of each process is estimated
+ * from its page faults, at most once every TICKS timer ticks, as
+ * the number of its resident pages accessed since the previous
+ * estimate.  Once free frames drop below kswapd's low watermark, a
+ * process that holds more than its working set is over quota as
+ * well, so the pages it has stopped using go first. */
+
+#include "vm/rss.h"
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "vm/kswapd.h"
+#include "vm/vm.h"
+
+static int64_t ws_interval; /* Ticks between estimates, or 0 for none. */
+
+/* Statistics. */
+static long long evict_cnt, sample_cnt, limit_cnt;
+
+/* Estimates working sets every TICKS timer ticks; 0 turns the
+ * estimator off. */
+void rss_set_ws_interval(int64_t ticks)
+{
+    ws_interval = ticks;
+}
+
+/* Gives CHILD, a new process forked from PARENT, PARENT's limit. */
+void rss_fork(struct thread* child, const struct thread* parent)
+{
+    child->rss.limit = parent->rss.limit;
+}
+
+/* Adds DELTA pages to T's RSS.  The evictor changes other
+ * processes' counts, so interrupts are off for the update. */
+void rss_charge(struct thread* t, int delta)
+{
+    enum intr_level old_level = intr_disable();
+
+    t->rss.pages += delta;
+    if (t->rss.pages > t->rss.peak)
+        t->rss.peak = t->rss.pages;
+    intr_set_level(old_level);
+}
+
+/* Counts a page T evicted to stay within quota. */
+void rss_evicted(struct thread* t)
+{
+    t->rss.evict_cnt++;
+    evict_cnt++;
+}
+
+/* Returns true if T must replace one of its own pages instead of
+ * taking another frame. */
+bool rss_over_quota(struct thread* t)
+{
+    if (t->rss.limit > 0 && t->rss.pages >= t->rss.limit)
+        return true;
+    return ws_interval > 0 && t->rss.ws_size > 0 && t->rss.pages > t->rss.ws_size && kswapd_below_low();
+}
+
+/* Estimates T's working set again, if the last estimate is older
+ * than the sampling interval.  T must be the running thread. */
+void rss_sample(struct thread* t)
+{
+    int64_t now;
+
+    if (ws_interval == 0 || (now = timer_ticks()) - t->rss.ws_sampled < ws_interval)
+        return;
+    t->rss.ws_size = vm_sample_accessed(&t->spt);
+    t->rss.ws_sampled = now;
+    sample_cnt++;
+}
+
+/* Limits the running process to PAGES resident pages, or lifts
+ * its limit if PAGES is 0.  Pages beyond a new limit are evicted
+ * right away.  Returns 0. */
+int rss_set_limit(size_t pages)
+{
+    struct thread* t = thread_current();
+
+    t->rss.limit = pages;
+    if (pages > 0) {
+        limit_cnt++;
+        vm_trim_rss(pages);
+    }
+    return 0;
+}
+
+/* Stores the memory use of the running process in ST. */
+void rss_stat_get(struct mem_stat* st)
+{
+    struct thread* t = thread_current();
+
+    rss_sample(t);
+    st->rss = t->rss.pages;
+    st->rss_peak = t->rss.peak;
+    st->rss_limit = t->rss.limit;
+    st->ws_size = ws_interval > 0 ? t->rss.ws_size : 0;
+    st->evict_cnt = t->rss.evict_cnt;
+}
+
+void rss_print_stats(void)
+{
+    printf("RSS: %lld limits set, %lld own pages evicted, %lld working-set samples (every %lld ticks)\n", limit_cnt,
+           evict_cnt, sample_cnt, (long long)ws_interval);
+}
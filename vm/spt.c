@@ -0,0 +1,224 @@
+/* spt.c: Radix tree behind the supplemental page table.
+ *
+ * A user address is split into the same indices the MMU uses:
+ * PML4, PDPE and PDX select interior nodes and PTX selects the
+ * slot in a leaf that points to the struct page.  Each node is
+ * one page of 512 pointers.  Lookup is four array loads no matter
+ * how many pages the process has, and an in-order walk of the
+ * tree visits pages by ascending address.
+ *
+ * The leaf of the last lookup is remembered, because faults and
+ * loaders tend to touch neighbouring pages one after another. */
+
+#include "vm/spt.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "vm/vm.h"
+
+#define SPT_FANOUT (PGSIZE / sizeof(void*))
+#define SPT_LEVELS 4
+
+/* Shift of the index that selects a slot in a node at LEVEL,
+ * where leaves are level 0. */
+#define LEVEL_SHIFT(level) (PTXSHIFT + 9 * (level))
+#define LEVEL_INDEX(va, level) (((uint64_t)(va) >> LEVEL_SHIFT(level)) & (SPT_FANOUT - 1))
+
+/* Bytes of address space covered by one leaf. */
+#define LEAF_SPAN (1UL << LEVEL_SHIFT(1))
+
+static void** node_create(void)
+{
+    return palloc_get_page(PAL_ZERO);
+}
+
+static bool node_is_empty(void** node)
+{
+    size_t i;
+
+    for (i = 0; i < SPT_FANOUT; i++)
+        if (node[i] != NULL)
+            return false;
+    return true;
+}
+
+static void node_free(struct supplemental_page_table* spt, void** node)
+{
+    if (spt->hint == node)
+        spt->hint = NULL;
+    palloc_free_page(node);
+}
+
+/* Returns the leaf that covers VA, or a null pointer if there is
+ * none and CREATE is false or memory runs out. */
+static void** find_leaf(struct supplemental_page_table* spt, uint64_t va, bool create)
+{
+    void** node;
+    int level;
+
+    if (spt->hint != NULL && va - spt->hint_base < LEAF_SPAN)
+        return spt->hint;
+
+    if (spt->root == NULL) {
+        if (!create || (spt->root = node_create()) == NULL)
+            return NULL;
+    }
+
+    node = spt->root;
+    for (level = SPT_LEVELS - 1; level > 0; level--) {
+        void** child = node[LEVEL_INDEX(va, level)];
+
+        if (child == NULL) {
+            if (!create || (child = node_create()) == NULL)
+                return NULL;
+            node[LEVEL_INDEX(va, level)] = child;
+        }
+        node = child;
+    }
+
+    spt->hint = node;
+    spt->hint_base = va & ~(LEAF_SPAN - 1);
+    return node;
+}
+
+/* Initializes SPT as empty. */
+void spt_init(struct supplemental_page_table* spt)
+{
+    spt->root = NULL;
+    spt->page_cnt = 0;
+    spt->walkers = 0;
+    spt->hint = NULL;
+}
+
+/* Returns the page that contains VA, or a null pointer. */
+struct page* spt_lookup(struct supplemental_page_table* spt, const void* va)
+{
+    void** leaf = find_leaf(spt, (uint64_t)va, false);
+
+    return leaf != NULL ? leaf[LEVEL_INDEX(va, 0)] : NULL;
+}
+
+/* Inserts PAGE, keyed by its va.  Returns false if a page is
+ * already there or memory runs out. */
+bool spt_insert(struct supplemental_page_table* spt, struct page* page)
+{
+    void** leaf;
+    void** slot;
+
+    ASSERT(pg_ofs(page->va) == 0);
+    ASSERT(is_user_vaddr(page->va));
+
+    leaf = find_leaf(spt, (uint64_t)page->va, true);
+    if (leaf == NULL)
+        return false;
+    slot = &leaf[LEVEL_INDEX(page->va, 0)];
+    if (*slot != NULL)
+        return false;
+    *slot = page;
+    spt->page_cnt++;
+    return true;
+}
+
+/* Frees the empty nodes on the path to VA, bottom up. */
+static void prune_path(struct supplemental_page_table* spt, uint64_t va)
+{
+    void** path[SPT_LEVELS];
+    int level;
+
+    path[SPT_LEVELS - 1] = spt->root;
+    for (level = SPT_LEVELS - 1; level > 0; level--) {
+        path[level - 1] = path[level][LEVEL_INDEX(va, level)];
+        ASSERT(path[level - 1] != NULL);
+    }
+
+    for (level = 0; level < SPT_LEVELS && node_is_empty(path[level]); level++) {
+        node_free(spt, path[level]);
+        if (level + 1 < SPT_LEVELS)
+            path[level + 1][LEVEL_INDEX(va, level + 1)] = NULL;
+        else
+            spt->root = NULL;
+    }
+}
+
+/* Removes the page that contains VA and returns it, or returns a
+ * null pointer if there is none.  The page itself is not freed. */
+struct page* spt_delete(struct supplemental_page_table* spt, const void* va)
+{
+    void** leaf = find_leaf(spt, (uint64_t)va, false);
+    struct page* page;
+
+    if (leaf == NULL || leaf[LEVEL_INDEX(va, 0)] == NULL)
+        return NULL;
+
+    page = leaf[LEVEL_INDEX(va, 0)];
+    leaf[LEVEL_INDEX(va, 0)] = NULL;
+    spt->page_cnt--;
+
+    /* Nodes must stay put while an iteration may be inside them;
+     * spt_for_each() prunes what it passed once it is done. */
+    if (spt->walkers == 0)
+        prune_path(spt, (uint64_t)va);
+    return page;
+}
+
+/* Calls FUNC on each page of NODE, which sits at LEVEL and covers
+ * addresses from BASE, that lies in [START, END).  Frees children
+ * that end up empty if PRUNE.  Returns false if FUNC stopped the
+ * iteration. */
+static bool visit(struct supplemental_page_table* spt, void** node, int level, uint64_t base, uint64_t start,
+                  uint64_t end, spt_action_func* func, void* aux, bool prune)
+{
+    uint64_t span = 1UL << LEVEL_SHIFT(level);
+    size_t first = start > base ? LEVEL_INDEX(start, level) : 0;
+    size_t i;
+
+    for (i = first; i < SPT_FANOUT; i++) {
+        uint64_t va = base + i * span;
+
+        if (va >= end)
+            break;
+        if (node[i] == NULL)
+            continue;
+
+        if (level == 0) {
+            if (!func(node[i], aux))
+                return false;
+        } else {
+            bool more = visit(spt, node[i], level - 1, va, start, end, func, aux, prune);
+
+            if (prune && node_is_empty(node[i])) {
+                node_free(spt, node[i]);
+                node[i] = NULL;
+            }
+            if (!more)
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Calls FUNC on every page in [START, END), in ascending order of
+ * address, until FUNC returns false.  FUNC may remove the page it
+ * is given, and any other page.  Returns false if FUNC stopped
+ * the iteration, true otherwise. */
+bool spt_for_each(struct supplemental_page_table* spt, const void* start, const void* end, spt_action_func* func,
+                  void* aux)
+{
+    bool finished;
+
+    if (spt->root == NULL || start >= end)
+        return true;
+
+    spt->walkers++;
+    finished = visit(spt, spt->root, SPT_LEVELS - 1, 0, (uint64_t)start, (uint64_t)end, func, aux,
+                     spt->walkers == 1);
+    spt->walkers--;
+
+    if (spt->walkers == 0 && node_is_empty(spt->root)) {
+        node_free(spt, spt->root);
+        spt->root = NULL;
+    }
+    return finished;
+}
@@ -2,4 +2,13 @@ vm_SRC = vm/vm.c          # Main api proxy
 vm_SRC += vm/uninit.c     # Uninitialized page
 vm_SRC += vm/anon.c       # Anonymous page
 vm_SRC += vm/file.c       # File mapped page
+vm_SRC += vm/spt.c        # Supplemental page table
+vm_SRC += vm/vma.c        # Virtual memory regions
+vm_SRC += vm/text.c       # Shared executable text
+vm_SRC += vm/fault.c      # Page-fault statistics
+vm_SRC += vm/replace.c    # Page replacement policies
+vm_SRC += vm/kswapd.c     # Page-out daemon
+vm_SRC += vm/zswap.c      # Compressed swap cache
+vm_SRC += vm/ksm.c        # Samepage merging
+vm_SRC += vm/rss.c        # Resident-set limits
 vm_SRC += vm/inspect.c    # Testing utility
@@ -0,0 +1,91 @@
+/* text.c: Frames of executable code shared between processes.
+ *
+ * Processes that run the same executable would each read their
+ * own copy of every page of its read-only segments.  Instead, a
+ * frame that holds such a page is entered here under the file's
+ * inode and the page's offset in it, and the next process to fault
+ * on the same page maps that frame too.  The frame's list of pages
+ * tells the evictor whom to unmap, and the frame leaves the table
+ * when it is evicted or its last page goes away.
+ *
+ * Executables cannot be written while they run, so a frame in the
+ * table always matches the file.  Everything here is called with
+ * frame_lock held. */
+
+#include "vm/text.h"
+#include <hash.h>
+#include <stdio.h>
+#include "vm/vm.h"
+
+static struct hash text_frames;
+
+/* Statistics. */
+static long long hit_cnt, miss_cnt;
+
+static uint64_t text_hash(const struct hash_elem* e, void* aux UNUSED)
+{
+    const struct frame* f = hash_entry(e, struct frame, text_elem);
+
+    return hash_bytes(&f->text_inode, sizeof f->text_inode) ^ hash_int(f->text_offset);
+}
+
+static bool text_less(const struct hash_elem* a_, const struct hash_elem* b_, void* aux UNUSED)
+{
+    const struct frame* a = hash_entry(a_, struct frame, text_elem);
+    const struct frame* b = hash_entry(b_, struct frame, text_elem);
+
+    if (a->text_inode != b->text_inode)
+        return a->text_inode < b->text_inode;
+    return a->text_offset < b->text_offset;
+}
+
+void text_init(void)
+{
+    if (!hash_init(&text_frames, text_hash, text_less, NULL))
+        PANIC("text: cannot allocate table");
+}
+
+/* Returns the frame that holds the page at OFFSET in INODE, or a
+ * null pointer. */
+struct frame* text_lookup(struct inode* inode, off_t offset)
+{
+    struct frame key;
+    struct hash_elem* e;
+
+    key.text_inode = inode;
+    key.text_offset = offset;
+    e = hash_find(&text_frames, &key.text_elem);
+    if (e == NULL) {
+        miss_cnt++;
+        return NULL;
+    }
+    hit_cnt++;
+    return hash_entry(e, struct frame, text_elem);
+}
+
+/* Enters FRAME, which holds the page at OFFSET in INODE, unless
+ * another frame holds that page already. */
+void text_insert(struct frame* frame, struct inode* inode, off_t offset)
+{
+    ASSERT(frame->text_inode == NULL);
+
+    frame->text_inode = inode;
+    frame->text_offset = offset;
+    if (hash_insert(&text_frames, &frame->text_elem) != NULL)
+        frame->text_inode = NULL;
+}
+
+/* Removes FRAME from the table, if it is there. */
+void text_remove(struct frame* frame)
+{
+    if (frame->text_inode == NULL)
+        return;
+    hash_delete(&text_frames, &frame->text_elem);
+    frame->text_inode = NULL;
+}
+
+/* Prints text sharing statistics. */
+void text_print_stats(void)
+{
+    printf("Text: %zu frames shared, %lld hits, %lld misses\n", hash_size(&text_frames), hit_cnt, miss_cnt);
+}
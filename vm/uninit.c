@@ -59,6 +59,6 @@ static bool uninit_initialize(struct page* page, void* kva)
 static void uninit_destroy(struct page* page)
 {
     struct uninit_page* uninit UNUSED = &page->uninit;
-    /* TODO: Fill this function.
-     * TODO: If you don't have anything to do, just return. */
+    /* AUX belongs to whoever created the page (for region pages,
+     * the region itself), so there is nothing to free. */
 }
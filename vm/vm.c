@@ -1,20 +1,52 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "threads/malloc.h"
+#include "threads/vmalloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/kswapd.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
 #include "userprog/process.h"
+#include "userprog/syscall.h"
+#include "intrinsic.h"
 #include <bitmap.h>
+#include <round.h>
+#include <stdlib.h>
+#include <string.h>
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
 
+/* Most anonymous pages that one eviction writes to swap together. */
+#define EVICT_CLUSTER 8
+
+/* Most dirty file-backed frames that one vm_flush_frames() writes. */
+#define FLUSH_BATCH 32
+
+/* One frame per page the user pool can ever hold: frames[i]
+ * stands for the page I pages past FRAMES_BASE, whether or not it
+ * is in use.  Pages come from palloc the first time they are
+ * needed; once freed they stay with the frame on FREE_FRAMES,
+ * so that allocating and freeing a frame is a list operation
+ * under frame_lock.  The reclaim hook hands them back to palloc
+ * when the kernel pool wants their chunk. */
 static struct frame* frames;
-static struct bitmap* frame_table;
+static uint8_t* frames_base;
+static struct bitmap* frame_table; /* Frames in use. */
+static size_t frames_pages;        /* Pages backing FRAMES, from vmalloc(). */
+static struct list free_frames;    /* Frames with a page, not in use. */
+static size_t free_frame_cnt;      /* Frames on FREE_FRAMES. */
 static struct lock frame_lock;
-static void init_frame_table();
-void cleanup_frame_table();
+
+/* A page of zeros that every untouched anonymous page is mapped to,
+ * read-only, until it is first written.  It is not in FRAMES, so
+ * the evictor never sees it. */
+static struct frame zero_frame;
+static void init_frame_table(void);
+static bool vm_evict(struct frame* victims[], size_t cnt);
+static void frame_link(struct frame* frame, struct page* page);
+static void frame_unlink(struct frame* frame, struct page* page);
+static size_t vm_reclaim_chunk(void* pages, size_t page_cnt);
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -29,23 +61,71 @@ void vm_init(void)
     /* DO NOT MODIFY UPPER LINES. */
 
     init_frame_table();
+    text_init();
+    ksm_init();
+    palloc_set_reclaim(PAL_USER, vm_reclaim_chunk);
+    zero_frame.kva = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+    zero_frame.pinned = true;
+    kswapd_init();
+}
+
+/* Returns the frame that stands for user pool page KVA. */
+static struct frame* frame_of(const void* kva)
+{
+    return &frames[pg_no(kva) - pg_no(frames_base)];
+}
+
+/* Reclaim hook for the user pool: the kernel pool wants the
+ * PAGE_CNT pages at PAGES.  Gives back the free frames in that
+ * range, evicts the rest, and returns how many were released. */
+static size_t vm_reclaim_chunk(void* pages, size_t page_cnt)
+{
+    size_t first = frame_of(pages) - frames;
+    size_t last = first + page_cnt < bitmap_size(frame_table) ? first + page_cnt : bitmap_size(frame_table);
+    size_t reclaimed = 0;
+    size_t i;
+
+    /* A kernel allocation made while evicting must not recurse. */
+    if (lock_held_by_current_thread(&frame_lock))
+        return 0;
+
+    lock_acquire(&frame_lock);
+    for (i = first; i < last; i++) {
+        struct frame* frame = &frames[i];
+
+        if (frame->kva == NULL)
+            continue;
+        if (!bitmap_test(frame_table, i)) {
+            list_remove(&frame->free_elem);
+            free_frame_cnt--;
+        } else if (frame->pinned || (frame->ref_cnt > 0 && !vm_evict(&frame, 1)))
+            continue;
+        palloc_free_page(frame->kva);
+        frame->kva = NULL;
+        bitmap_reset(frame_table, i);
+        reclaimed++;
+    }
+    lock_release(&frame_lock);
+    return reclaimed;
 }
 
-static void init_frame_table()
+static void init_frame_table(void)
 {
     size_t frame_count = user_pool_pages();
     frame_table = bitmap_create(frame_count);
-    frames = malloc(sizeof *frames * frame_count);
-    for (size_t i = 0; i < frame_count; i++) {
-        frames[i].kva = NULL;
-        frames[i].page = NULL;
-    }
+    /* One entry per user page can span many pages; it does not
+     * need to be physically contiguous. */
+    frames_pages = DIV_ROUND_UP(sizeof *frames * frame_count, PGSIZE);
+    frames = vmalloc(PAL_ASSERT | PAL_ZERO, frames_pages);
+    frames_base = user_pool_base();
+    list_init(&free_frames);
+    replace_init(frame_count);
     lock_init(&frame_lock);
 }
 
-void cleanup_frame_table()
+void cleanup_frame_table(void)
 {
-    free(frames);
+    vfree(frames, frames_pages);
     bitmap_destroy(frame_table);
 }
 
@@ -65,10 +145,27 @@ enum vm_type page_get_type(struct page* page)
 
 /* Helpers */
 static struct frame* vm_get_victim(void);
+static bool page_map(struct page* page);
 static bool vm_do_claim_page(struct page* page);
-static struct frame* vm_evict_frame(void);
-static uint64_t spt_hash(const struct hash_elem* e, void* aux);
-static bool spt_hash_less(const struct hash_elem* a, const struct hash_elem* b, void* aux);
+static bool vm_claim_with(struct page* page, struct frame* frame);
+static struct frame* frame_take(void);
+static struct frame* frame_alloc(bool evict);
+static void vm_fault_around(struct vm_area* area, uint8_t* va);
+static void vm_drop_behind(struct supplemental_page_table* spt, uint8_t* va);
+static bool deactivate_page(struct page* page, void* aux);
+static bool vm_map_zero(struct vm_area* area, void* va);
+static enum fault_class handle_fault(struct intr_frame* f, void* addr, bool user, bool write, bool not_present);
+static bool vm_share_text(struct page* page);
+static struct frame* vm_evict_frame(size_t* evicted);
+static struct frame* vm_evict_own(struct thread* t);
+static bool pick_own(struct page* page, void* aux);
+static bool count_accessed(struct page* page, void* aux);
+static bool pin_page(struct thread* t, uint8_t* va, bool write);
+static void vm_free_frame(struct frame* frame);
+static bool copy_page(struct page* page, void* aux);
+static bool copy_init(struct page* page, void* aux);
+static bool kill_page(struct page* page, void* aux);
+static bool flush_page(struct page* page, void* aux);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -106,8 +203,13 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void* upage, bool writabl
 
         uninit_new(new_page, upage, init, type, aux, initializer);
         new_page->writable = writable;
+        new_page->owner = thread_current();
 
-        return spt_insert_page(spt, new_page);
+        if (!spt_insert_page(spt, new_page)) {
+            free(new_page);
+            return false;
+        }
+        return true;
     }
     return false;
 }
@@ -115,121 +217,978 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void* upage, bool writabl
 /* Find VA from spt and return page. On error, return NULL. */
 struct page* spt_find_page(struct supplemental_page_table* spt, void* va)
 {
-    struct page* page = NULL;
-    void* target = pg_round_down(va);
-    struct hash_iterator i;
-
-    // REF: lib/kernel/hash.c, 166:175
-    hash_first(&i, &spt->pages);
-    while (hash_next(&i)) {
-        page = hash_entry(hash_cur(&i), struct page, elem);
-        if (page->va == target)
-            return page;
-    }
-
-    return NULL;
+    return spt_lookup(spt, va);
 }
 
-/* Insert PAGE into spt with validation. */
+/* Insert PAGE into spt with validation.
+ * Returns false if PAGE->va is already taken or memory runs out. */
 bool spt_insert_page(struct supplemental_page_table* spt, struct page* page)
 {
     ASSERT(page != NULL);
     ASSERT(page->va != NULL);
-    hash_insert(&spt->pages, &page->elem);
-    ASSERT(hash_find(&spt->pages, &page->elem) == &page->elem)
-    // TODO:: `hash_insert` 함수는 동일한 element가 이미 존재하면 기존 element를 리턴한다.
-    // 이 경우에 대한 예외처리가 필요하다.
 
-    return true;
+    return spt_insert(spt, page);
 }
 
 void spt_remove_page(struct supplemental_page_table* spt, struct page* page)
 {
+    struct page* removed UNUSED = spt_delete(spt, page->va);
+
+    ASSERT(removed == page);
     vm_dealloc_page(page);
+}
+
+/* Makes PAGE one of the pages that use FRAME.  Must be called with
+ * frame_lock held, or on a frame that is pinned and not yet
+ * visible to anyone else. */
+static void frame_link(struct frame* frame, struct page* page)
+{
+    /* The first page stays in front; sharers go right behind it.
+     * The zero frame is never evicted, so it needs no reverse map,
+     * and could have thousands of pages in one. */
+    if (frame == &zero_frame)
+        page->rmap_next = NULL;
+    else if (frame->rmap == NULL) {
+        page->rmap_next = NULL;
+        frame->rmap = page;
+    } else {
+        page->rmap_next = frame->rmap->rmap_next;
+        frame->rmap->rmap_next = page;
+    }
+    if (frame != &zero_frame)
+        rss_charge(page->owner, 1);
+    frame->ref_cnt++;
+    page->frame = frame;
+}
+
+/* Removes PAGE from FRAME's reverse map, but leaves PAGE->FRAME. */
+static void rmap_remove(struct frame* frame, struct page* page)
+{
+    struct page** p;
+
+    frame->ref_cnt--;
+    if (frame == &zero_frame)
+        return;
+    rss_charge(page->owner, -1);
+    for (p = &frame->rmap; *p != page; p = &(*p)->rmap_next)
+        ASSERT(*p != NULL);
+    *p = page->rmap_next;
+    page->rmap_next = NULL;
+}
+
+/* Undoes frame_link(). */
+static void frame_unlink(struct frame* frame, struct page* page)
+{
+    ASSERT(page->frame == frame);
+    rmap_remove(frame, page);
+    page->frame = NULL;
+}
+
+/* Clears every mapping of FRAME. */
+static void frame_unmap(struct frame* frame)
+{
+    struct page* page;
+
+    for (page = frame->rmap; page != NULL; page = page->rmap_next)
+        pml4_clear_page(page->owner->pml4, page->va);
+}
+
+/* Returns true if FRAME may be used by more than one page, so that
+ * none of them may write to it. */
+static bool frame_is_shared(struct frame* frame)
+{
+    return frame->ref_cnt > 1 || frame == &zero_frame;
+}
+
+/* Returns the first page that uses FRAME, which must be in use. */
+static struct page* frame_page(struct frame* frame)
+{
+    ASSERT(frame->rmap != NULL);
+    return frame->rmap;
+}
+
+/* Returns true if any page that uses FRAME was accessed since its
+ * accessed bit was last cleared.  If CLEAR, clears them all. */
+bool frame_accessed(struct frame* frame, bool clear)
+{
+    struct page* page;
+    bool accessed = false;
+
+    for (page = frame->rmap; page != NULL; page = page->rmap_next) {
+        if (pml4_is_accessed(page->owner->pml4, page->va)) {
+            accessed = true;
+            if (!clear)
+                break;
+            pml4_set_accessed(page->owner->pml4, page->va, false);
+        }
+    }
+    return accessed;
+}
+
+/* Maps PAGE to its frame in its owner's page table, writable only
+ * if PAGE is writable and not shared.  Returns false if memory
+ * for the page table runs out. */
+static bool page_map(struct page* page)
+{
+    struct frame* frame = page->frame;
+    uint64_t* pml4 = page->owner->pml4;
+
+    if (!pml4_set_page(pml4, page->va, frame->kva, page->writable && !frame_is_shared(frame)))
+        return false;
+    /* The page may have been mapped with other rights already. */
+    if (rcr3() == vtop(pml4))
+        invlpg((uint64_t)page->va);
     return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Get the struct frame, that will be evicted.
+ * The replacement policy chosen at boot picks it; see
+ * vm/replace.c.  Pinned frames are never picked.  Returns NULL
+ * only if every frame is pinned.  Must be called with frame_lock
+ * held. */
 static struct frame* vm_get_victim(void)
 {
-    struct frame* victim = NULL;
-    /* TODO: The policy for eviction is up to you. */
+    ASSERT(lock_held_by_current_thread(&frame_lock));
 
-    return victim;
+    return replace_victim();
+}
+
+/* Writes the pages in the CNT frames of VICTIMS out to their
+ * backing store and unlinks them from their frames.  More than one
+ * victim must all hold anonymous pages, which then go to swap as
+ * one cluster.  A shared anonymous frame is written once, and all
+ * its pages share the swap slot; shared text is just dropped.
+ * Every page in a victim's reverse map is unmapped first, so their
+ * owners fault on them instead of writing behind our back.
+ * Returns false, leaving every page mapped, if they cannot be
+ * written out.  Must be called with frame_lock held. */
+static bool vm_evict(struct frame* victims[], size_t cnt)
+{
+    struct page* pages[EVICT_CLUSTER];
+    bool dirty[EVICT_CLUSTER];
+    bool ok;
+    size_t i;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(cnt > 0 && cnt <= EVICT_CLUSTER);
+
+    /* The PTE keeps its dirty bit while not present, for
+     * file-backed pages to check in swap_out().  Those are never
+     * shared, so only the first page's bit matters. */
+    for (i = 0; i < cnt; i++) {
+        pages[i] = frame_page(victims[i]);
+        dirty[i] = pml4_is_dirty(pages[i]->owner->pml4, pages[i]->va);
+        frame_unmap(victims[i]);
+    }
+
+    ok = cnt == 1 ? swap_out(pages[0]) : anon_swap_out_cluster(pages, cnt);
+
+    for (i = 0; i < cnt; i++) {
+        struct page* page;
+
+        if (!ok) {
+            for (page = victims[i]->rmap; page != NULL; page = page->rmap_next)
+                page_map(page);
+            pml4_set_dirty(pages[i]->owner->pml4, pages[i]->va, dirty[i]);
+            continue;
+        }
+        /* Shared text is clean and reads back from the file. */
+        text_remove(victims[i]);
+        ksm_remove(victims[i]);
+        replace_remove(victims[i], true);
+        while ((page = victims[i]->rmap) != NULL) {
+            if (page != pages[i] && VM_TYPE(page->operations->type) == VM_ANON)
+                anon_swap_dup(page, pages[i]);
+            frame_unlink(victims[i], page);
+        }
+    }
+    return ok;
+}
+
+/* Fills VICTIMS, whose first entry holds an anonymous page, with
+ * the frames the policy would pick next, as long as they also hold
+ * anonymous pages.  Taken frames are pinned.  Returns the number
+ * of victims, at most EVICT_CLUSTER. */
+static size_t vm_gather_cluster(struct frame* victims[])
+{
+    size_t cnt = 1;
+
+    while (cnt < EVICT_CLUSTER) {
+        struct frame* frame = vm_get_victim();
+
+        if (frame == NULL || VM_TYPE(frame_page(frame)->operations->type) != VM_ANON)
+            break;
+        frame->pinned = true;
+        victims[cnt++] = frame;
+    }
+    return cnt;
 }
 
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
-static struct frame* vm_evict_frame(void)
+ * Return NULL on error.  An anonymous victim takes the pages the
+ * policy would evict right after it to swap in the same write;
+ * their frames are freed.  If EVICTED is nonnull, stores the number
+ * of pages evicted in *EVICTED. */
+static struct frame* vm_evict_frame(size_t* evicted)
 {
-    struct frame* victim UNUSED = vm_get_victim();
-    /* TODO: swap out the victim and return the evicted frame. */
+    size_t tries;
+
+    /* Victims whose swap_out() fails are left mapped, and the
+     * policy moves past them. */
+    for (tries = bitmap_size(frame_table); tries > 0; tries--) {
+        struct frame* victims[EVICT_CLUSTER];
+        size_t cnt = 1, i;
 
+        victims[0] = vm_get_victim();
+        if (victims[0] == NULL)
+            break;
+        victims[0]->pinned = true;
+        if (VM_TYPE(frame_page(victims[0])->operations->type) == VM_ANON)
+            cnt = vm_gather_cluster(victims);
+
+        if (!vm_evict(victims, cnt) && (cnt == 1 || !vm_evict(victims, 1))) {
+            for (i = 0; i < cnt; i++)
+                victims[i]->pinned = false;
+            replace_skip(victims[0]);
+            continue;
+        }
+        for (i = 1; i < cnt; i++) {
+            if (victims[i]->ref_cnt > 0)
+                victims[i]->pinned = false;
+            else
+                vm_free_frame(victims[i]);
+        }
+        if (evicted != NULL)
+            *evicted = cnt;
+        return victims[0];
+    }
     return NULL;
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it.  The frame is returned pinned, for the caller to
+ * fill and map before unpinning it.  Returns NULL only if nothing
+ * can be evicted, e.g. when swap is full. */
 static struct frame* vm_get_frame(void)
+{
+    return frame_alloc(true);
+}
+
+/* Takes a free frame: a recycled one from FREE_FRAMES if there is
+ * one, otherwise the frame of a fresh page from the user pool.
+ * Returns NULL if there is neither. */
+static struct frame* frame_take(void)
 {
     struct frame* frame;
 
-    lock_acquire(&frame_lock);
+    ASSERT(lock_held_by_current_thread(&frame_lock));
 
-    size_t free_frame_index = bitmap_scan_and_flip(frame_table, 0, 1, false); /* 가용 프레임 체크 */
-    if (free_frame_index >= 0 && free_frame_index < user_pool_pages()) {
-        frame = &frames[free_frame_index];
+    if (!list_empty(&free_frames)) {
+        frame = list_entry(list_pop_front(&free_frames), struct frame, free_elem);
+        free_frame_cnt--;
     } else {
-        // 없으면, evict 진행후 프레임 바인딩
-        PANIC("no available frame");
+        void* kva = palloc_get_page(PAL_USER);
+
+        if (kva == NULL)
+            return NULL;
+        frame = frame_of(kva);
+        frame->kva = kva;
     }
+    bitmap_mark(frame_table, frame - frames);
+    return frame;
+}
 
-    void* upage = palloc_get_page(PAL_USER);
-    if (upage == NULL) {
-        free(frame);
-        PANIC("palloc frame failed.");
+/* Returns a pinned frame, from the user pool or, if EVICT, by
+ * evicting a page.  Returns NULL if there is none. */
+static struct frame* frame_alloc(bool evict)
+{
+    struct thread* t = thread_current();
+    struct frame* frame = NULL;
+    bool direct = false;
+
+    /* A process over its quota replaces one of its own pages, and
+     * takes a free frame only if it has none to give up. */
+    if (rss_over_quota(t)) {
+        if (!evict)
+            return NULL;
+        lock_acquire(&frame_lock);
+        frame = vm_evict_own(t);
+        lock_release(&frame_lock);
+        if (frame != NULL)
+            return frame;
     }
 
-    frame->kva = upage;
+    lock_acquire(&frame_lock);
+    frame = frame_take();
+    if (frame == NULL && evict) {
+        frame = vm_evict_frame(NULL);
+        direct = frame != NULL;
+    }
+    if (frame != NULL) {
+        ASSERT(frame->ref_cnt == 0);
+        frame->pinned = true;
+    }
+    kswapd_poke(direct);
     lock_release(&frame_lock);
+    return frame;
+}
+
+/* Returns roughly how many frames can be allocated without
+ * evicting anything: those on the free list plus the pages the
+ * user pool can still hand out. */
+size_t vm_free_frame_cnt(void)
+{
+    return free_frame_cnt + palloc_free_pages(PAL_USER);
+}
+
+/* Evicts pages until there are TARGET free frames, or
+ * nothing more can be evicted; for the page-out daemon.
+ * frame_lock is dropped after each eviction so that faults are
+ * not held up behind a long run.  Returns the number of pages
+ * evicted. */
+size_t vm_reclaim_frames(size_t target)
+{
+    size_t evicted = 0;
+
+    while (vm_free_frame_cnt() < target) {
+        struct frame* frame;
+        size_t cnt;
 
-    ASSERT(frame != NULL);
-    ASSERT(frame->page == NULL);
+        lock_acquire(&frame_lock);
+        frame = vm_evict_frame(&cnt);
+        if (frame != NULL) {
+            vm_free_frame(frame);
+            evicted += cnt;
+        }
+        lock_release(&frame_lock);
+        if (frame == NULL)
+            break;
+    }
+    return evicted;
+}
+
+/* Evicts one of T's own pages, for T to reuse its frame, and
+ * returns the frame pinned.  The victim is found by a clock that
+ * sweeps T's address space from where it last stopped, sparing
+ * once each page accessed since the hand passed it.  Frames shared
+ * with other processes are not T's alone to give up.  Returns NULL
+ * if there is no such page or it cannot be written out.  Must be
+ * called with frame_lock held. */
+static struct frame* vm_evict_own(struct thread* t)
+{
+    struct page* victim = NULL;
+    struct frame* frame;
+    int pass;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    /* The first sweep may only clear accessed bits. */
+    for (pass = 0; pass < 2 && victim == NULL; pass++)
+        if (spt_for_each(&t->spt, t->rss.hand, (void*)KERN_BASE, pick_own, &victim))
+            spt_for_each(&t->spt, NULL, t->rss.hand, pick_own, &victim);
+    if (victim == NULL)
+        return NULL;
+
+    t->rss.hand = (uint8_t*)victim->va + PGSIZE;
+    frame = victim->frame;
+    frame->pinned = true;
+    if (!vm_evict(&frame, 1)) {
+        frame->pinned = false;
+        return NULL;
+    }
+    rss_evicted(t);
     return frame;
 }
 
-/* Growing the stack. */
-static void vm_stack_growth(void* addr UNUSED)
+/* Returns true if PAGE was accessed since its accessed bit was
+ * last cleared, and clears it.  Its frame is then marked fresh, so
+ * that the replacement policy, which would have seen the bit,
+ * still spares it once.  Must be called with frame_lock held. */
+static bool page_test_accessed(struct page* page)
 {
+    if (!pml4_is_accessed(page->owner->pml4, page->va))
+        return false;
+    pml4_set_accessed(page->owner->pml4, page->va, false);
+    page->frame->lru_fresh = true;
+    return true;
 }
 
-/* Handle the fault on write_protected page */
-static bool vm_handle_wp(struct page* page UNUSED)
+/* Stops at PAGE, storing it in *AUX, if it is a victim for
+ * vm_evict_own(). */
+static bool pick_own(struct page* page, void* aux)
 {
+    struct page** victim = aux;
+    struct frame* frame = page->frame;
+
+    if (frame == NULL || frame_is_shared(frame) || frame->pinned || page_test_accessed(page))
+        return true;
+    *victim = page;
+    return false;
 }
 
-/* Return true on success */
-bool vm_try_handle_fault(struct intr_frame* f, void* addr, bool user, bool write, bool not_present)
+/* Returns the number of pages of SPT, which belongs to the running
+ * process, that are in frames and were accessed since the last
+ * call, for the working-set estimate in vm/rss.c. */
+size_t vm_sample_accessed(struct supplemental_page_table* spt)
+{
+    size_t cnt = 0;
+
+    lock_acquire(&frame_lock);
+    spt_for_each(spt, NULL, (void*)KERN_BASE, count_accessed, &cnt);
+    lock_release(&frame_lock);
+    return cnt;
+}
+
+static bool count_accessed(struct page* page, void* aux)
+{
+    size_t* cnt = aux;
+
+    if (page->frame != NULL && page->frame != &zero_frame && page_test_accessed(page))
+        (*cnt)++;
+    return true;
+}
+
+/* Evicts pages of the running process until it holds at most
+ * TARGET, or none of the rest can go.  Returns the number of pages
+ * evicted. */
+size_t vm_trim_rss(size_t target)
+{
+    struct thread* t = thread_current();
+    size_t evicted = 0;
+
+    while (t->rss.pages > target) {
+        struct frame* frame;
+
+        lock_acquire(&frame_lock);
+        frame = vm_evict_own(t);
+        if (frame != NULL)
+            vm_free_frame(frame);
+        lock_release(&frame_lock);
+        if (frame == NULL)
+            break;
+        evicted++;
+    }
+    return evicted;
+}
+
+/* Pins the pages of the SIZE bytes at UADDR in their frames, so
+ * that the kernel can access them without faulting, e.g. while it
+ * holds filesys_lock.  A page that is not in memory, or that is
+ * mapped read-only when WRITE is true, is faulted in first, the way
+ * the access itself would have faulted it.  Returns false, with
+ * nothing pinned, if the access would be invalid.  The frames stay
+ * pinned until vm_unpin_range(). */
+bool vm_pin_range(const void* uaddr, size_t size, bool write)
+{
+    struct thread* t = thread_current();
+    uint8_t* start = pg_round_down(uaddr);
+    uint8_t* end = (uint8_t*)uaddr + size;
+    uint8_t* p;
+
+    if (size == 0)
+        return true;
+    if (end < (uint8_t*)uaddr || !is_user_vaddr(end - 1))
+        return false;
+
+    for (p = start; p < end; p += PGSIZE) {
+        if (!pin_page(t, p, write)) {
+            if (p > start)
+                vm_unpin_range(start, p - start);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Pins T's page at VA for vm_pin_range(). */
+static bool pin_page(struct thread* t, uint8_t* va, bool write)
+{
+    for (;;) {
+        struct page* page;
+        struct frame* frame;
+        bool mapped;
+
+        lock_acquire(&frame_lock);
+        page = spt_find_page(&t->spt, va);
+        if (page != NULL && write && !page->writable) {
+            /* Resident read-only pages would pass the test below. */
+            lock_release(&frame_lock);
+            return false;
+        }
+        frame = page != NULL ? page->frame : NULL;
+        mapped = pml4_get_page(t->pml4, va) != NULL;
+        if (frame != NULL && mapped && !(write && frame_is_shared(frame))) {
+            /* The zero frame never leaves memory. */
+            bool done = frame == &zero_frame || frame->pin_cnt > 0 || !frame->pinned;
+
+            if (done && frame != &zero_frame) {
+                frame->pin_cnt++;
+                frame->pinned = true;
+            }
+            lock_release(&frame_lock);
+            if (done)
+                return true;
+            /* Still being filled. */
+            thread_yield();
+            continue;
+        }
+        lock_release(&frame_lock);
+
+        if (!vm_try_handle_fault(NULL, va, false, write, !mapped))
+            return false;
+    }
+}
+
+/* Unpins the pages of the SIZE bytes at UADDR, which
+ * vm_pin_range() pinned. */
+void vm_unpin_range(const void* uaddr, size_t size)
 {
     struct supplemental_page_table* spt = &thread_current()->spt;
-    struct page* page = NULL;
+    uint8_t* end = (uint8_t*)uaddr + size;
+    uint8_t* p;
+
+    lock_acquire(&frame_lock);
+    for (p = pg_round_down(uaddr); p < end; p += PGSIZE) {
+        struct page* page = spt_find_page(spt, p);
+        struct frame* frame = page->frame;
 
-    if (addr == NULL) {
-        PANIC("addr == NULL");
+        ASSERT(frame != NULL);
+        if (frame == &zero_frame)
+            continue;
+        ASSERT(frame->pin_cnt > 0);
+        if (--frame->pin_cnt == 0)
+            frame->pinned = false;
     }
-    if (!is_user_vaddr(addr)) {
-        PANIC("not user addr");
+    lock_release(&frame_lock);
+}
+
+/* Maps every page of FRAME read-only, so that no one can write to
+ * it while it is compared. */
+static void frame_protect(struct frame* frame)
+{
+    struct page* page;
+
+    for (page = frame->rmap; page != NULL; page = page->rmap_next) {
+        pml4_set_page(page->owner->pml4, page->va, frame->kva, false);
+        if (rcr3() == vtop(page->owner->pml4))
+            invlpg((uint64_t)page->va);
     }
+}
 
-    page = spt_find_page(&thread_current()->spt, addr);
+/* Undoes frame_protect(). */
+static void frame_remap(struct frame* frame)
+{
+    struct page* page;
+
+    for (page = frame->rmap; page != NULL; page = page->rmap_next)
+        page_map(page);
+}
+
+/* Merges FRAME, which holds anonymous pages, with a frame of the
+ * same contents, if its checksum held still since the last scan
+ * and there is one.  Every page of FRAME moves to the other frame,
+ * read-only, and FRAME is freed.  Returns true if FRAME was
+ * merged.  Must be called with frame_lock held. */
+static bool ksm_merge(struct frame* frame)
+{
+    unsigned sum = hash_bytes(frame->kva, PGSIZE);
+    struct frame* twin;
+    struct page* page;
+
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+
+    if (sum != frame->ksm_sum) {
+        ksm_remove(frame);
+        frame->ksm_sum = sum;
+        return false;
+    }
+    if (frame->ksm_listed)
+        return false;
+
+    frame_protect(frame);
+    if (memcmp(frame->kva, zero_frame.kva, PGSIZE) == 0)
+        twin = &zero_frame;
+    else {
+        twin = ksm_lookup(sum);
+        if (twin == NULL || twin->pinned) {
+            if (twin == NULL)
+                ksm_insert(frame);
+            frame_remap(frame);
+            return false;
+        }
+        frame_protect(twin);
+        if (memcmp(frame->kva, twin->kva, PGSIZE) != 0) {
+            /* TWIN changed since it was entered. */
+            frame_remap(twin);
+            ksm_remove(twin);
+            ksm_insert(frame);
+            frame_remap(frame);
+            return false;
+        }
+    }
+
+    while ((page = frame->rmap) != NULL) {
+        frame_unlink(frame, page);
+        frame_link(twin, page);
+        page_map(page);
+    }
+    vm_free_frame(frame);
+    return true;
+}
+
+/* Examines the next CNT frames that hold anonymous pages for
+ * samepage merging, for the ksm thread, taking frame_lock for one
+ * frame at a time.  Goes around the frame table at most once.
+ * Stores the number of frames merged away in *MERGED and returns
+ * the number examined. */
+size_t vm_ksm_scan(size_t cnt, size_t* merged)
+{
+    static size_t cursor;
+    size_t frame_cnt = bitmap_size(frame_table);
+    size_t scanned = 0, i;
+
+    *merged = 0;
+    for (i = 0; i < frame_cnt && scanned < cnt; i++) {
+        struct frame* frame = &frames[cursor];
+
+        cursor = (cursor + 1) % frame_cnt;
+        lock_acquire(&frame_lock);
+        if (bitmap_test(frame_table, frame - frames) && !frame->pinned && frame->ref_cnt > 0
+            && VM_TYPE(frame_page(frame)->operations->type) == VM_ANON) {
+            scanned++;
+            if (ksm_merge(frame))
+                (*merged)++;
+        }
+        lock_release(&frame_lock);
+    }
+    return scanned;
+}
+
+/* Puts FRAME, with its page, on the free list.  Must be called
+ * with frame_lock held. */
+static void vm_free_frame(struct frame* frame)
+{
+    ASSERT(lock_held_by_current_thread(&frame_lock));
+    ASSERT(frame->ref_cnt == 0);
+
+    text_remove(frame);
+    ksm_remove(frame);
+    replace_remove(frame, false);
+    frame->pinned = false;
+    bitmap_reset(frame_table, frame - frames);
+    list_push_front(&free_frames, &frame->free_elem);
+    free_frame_cnt++;
+}
+
+/* Growing the stack.  Returns true if ADDR is now part of the
+ * stack region. */
+static bool vm_stack_growth(void* addr)
+{
+    return vma_grow_stack(&thread_current()->spt, addr);
+}
+
+/* Handle the fault on write_protected page: a write to a
+ * copy-on-write page.  The faulting process gets a private copy of
+ * the frame, or the frame itself once no one else shares it. */
+static bool vm_handle_wp(struct page* page)
+{
+    struct frame* old;
+    struct frame* copy;
+
+    lock_acquire(&frame_lock);
+    old = page->frame;
+    if (old != NULL && !frame_is_shared(old)) {
+        bool ok = page_map(page);
+
+        lock_release(&frame_lock);
+        return ok;
+    }
+    lock_release(&frame_lock);
+
+    /* Allocating may evict, even OLD itself. */
+    copy = vm_get_frame();
+    if (copy == NULL)
+        return false;
+
+    lock_acquire(&frame_lock);
+    old = page->frame;
+    if (old == NULL || !frame_is_shared(old)) {
+        /* Evicted, or no longer shared: start over. */
+        vm_free_frame(copy);
+        lock_release(&frame_lock);
+        return old == NULL ? vm_do_claim_page(page) : vm_handle_wp(page);
+    }
+    memcpy(copy->kva, old->kva, PGSIZE);
+    frame_unlink(old, page);
+    frame_link(copy, page);
+    /* The other sharers become writable again on their next write
+     * fault, if they are left alone on OLD. */
+    if (!page_map(page)) {
+        frame_unlink(copy, page);
+        frame_link(old, page);
+        vm_free_frame(copy);
+        lock_release(&frame_lock);
+        return false;
+    }
+    replace_add(copy);
+    copy->pinned = false;
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Return true on success.  Each fault is timed and counted by
+ * its class; see vm/fault.c. */
+bool vm_try_handle_fault(struct intr_frame* f, void* addr, bool user, bool write, bool not_present)
+{
+    struct thread* t = thread_current();
+    uint64_t start = rdtsc();
+    uint64_t io_start = t->disk_cycles;
+    uint64_t read_start = t->disk_read_cnt;
+    bool filesys_locked = lock_held_by_current_thread(&filesys_lock);
+    enum fault_class class = handle_fault(f, addr, user, write, not_present);
+
+    /* A fault that had to read from disk is major, whatever else
+     * it did. */
+    if (class == FAULT_MINOR && t->disk_read_cnt != read_start)
+        class = FAULT_MAJOR;
+    fault_account(class, rdtsc() - start, t->disk_cycles - io_start, filesys_locked);
+    return class != FAULT_INVALID;
+}
+
+/* Resolves a fault and returns its class: FAULT_INVALID if it
+ * cannot be resolved, FAULT_MINOR for a page that came from a
+ * file or swap, whether or not that needed the disk. */
+static enum fault_class handle_fault(struct intr_frame* f, void* addr, bool user, bool write, bool not_present)
+{
+    struct thread* t = thread_current();
+    struct supplemental_page_table* spt = &t->spt;
+    struct page* page = NULL;
+    struct vm_area* area = NULL;
+    enum fault_class class = FAULT_MINOR;
+
+    rss_sample(t);
+    if (addr == NULL || !is_user_vaddr(addr))
+        return FAULT_INVALID;
+
+    page = spt_find_page(spt, addr);
+    if (!not_present) {
+        /* Rights violation: only writes to copy-on-write pages are
+         * legal. */
+        if (page == NULL || !write || !page->writable)
+            return FAULT_INVALID;
+        return vm_handle_wp(page) ? FAULT_COW : FAULT_INVALID;
+    }
     if (page == NULL) {
-        PANIC("page null error");
+        /* First touch: make the page from its region.  An access
+         * just below the stack, or at most 8 bytes under rsp (for
+         * PUSH), grows the stack. */
+        uint8_t* rsp = user ? (uint8_t*)f->rsp : t->user_rsp;
+
+        area = vma_find(spt, addr);
+        if (area == NULL && (uint8_t*)addr >= rsp - 8 && vm_stack_growth(addr)) {
+            area = vma_find(spt, addr);
+            class = FAULT_STACK;
+        }
+        if (area == NULL)
+            return FAULT_INVALID;
+        if (class == FAULT_MINOR && (size_t)((uint8_t*)pg_round_down(addr) - area->start) >= area->read_bytes) {
+            if (!write && area->type == VM_ANON)
+                return vm_map_zero(area, pg_round_down(addr)) ? FAULT_ZERO : FAULT_INVALID;
+            class = FAULT_ZERO;
+        }
+        page = vma_materialize(area, addr);
+        if (page == NULL)
+            return FAULT_INVALID;
+    }
+    if (write && !page->writable)
+        return FAULT_INVALID;
+
+    if (!vm_do_claim_page(page))
+        return FAULT_INVALID;
+    if (area != NULL && area->file != NULL)
+        vm_fault_around(area, page->va);
+    vm_drop_behind(spt, page->va);
+    return class;
+}
+
+/* Maps the page at VA in AREA, whose contents are all zeros and
+ * which is being read for the first time, to the zero frame.  The
+ * page gets a frame of its own on its first write, through
+ * vm_handle_wp(). */
+static bool vm_map_zero(struct vm_area* area, void* va)
+{
+    struct page* page;
+    bool ok;
+
+    if (!vm_alloc_page(VM_ANON, va, area->writable))
         return false;
+    page = spt_find_page(&thread_current()->spt, va);
+    /* Turns the uninit page into an anonymous one; with no
+     * initializer, this does not touch the frame. */
+    if (!swap_in(page, NULL))
+        return false;
+
+    lock_acquire(&frame_lock);
+    frame_link(&zero_frame, page);
+    ok = page_map(page);
+    if (!ok)
+        frame_unlink(&zero_frame, page);
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Fault-around: after a first touch at VA in AREA, which has a
+ * backing file, also loads the pages that follow, so a process
+ * that reads its executable or a mapped file front to back takes
+ * one fault per window instead of one per page.  The window
+ * starts at FAULT_AROUND_INIT pages, doubles while each fault
+ * lands just past the previous window, and halves otherwise, down
+ * to no neighbours for random access.  madvise() can fix the
+ * window at FAULT_AROUND_SEQ pages (MADV_SEQUENTIAL) or turn
+ * fault-around off (MADV_RANDOM).
+ *
+ * Only pages with file data are loaded, and only into free
+ * frames: fault-around never evicts.  The file layer has no
+ * vectored read, so the neighbours are read one after another
+ * under a single hold of filesys_lock. */
+static void vm_fault_around(struct vm_area* area, uint8_t* va)
+{
+    struct supplemental_page_table* spt = &thread_current()->spt;
+    uint8_t* end = area->start + ROUND_UP(area->read_bytes, PGSIZE);
+    uint8_t* p;
+    bool held;
+
+    if (area->advice == MADV_RANDOM)
+        return;
+    if (area->advice == MADV_SEQUENTIAL)
+        area->around_pages = FAULT_AROUND_SEQ;
+    else if (va == area->around_next)
+        area->around_pages = area->around_pages * 2 < FAULT_AROUND_MAX ? area->around_pages * 2 : FAULT_AROUND_MAX;
+    else if (area->around_next != NULL)
+        area->around_pages = area->around_pages / 2 > FAULT_AROUND_MIN ? area->around_pages / 2 : FAULT_AROUND_MIN;
+    if (va + area->around_pages * PGSIZE < end)
+        end = va + area->around_pages * PGSIZE;
+
+    held = filesys_enter();
+    for (p = va + PGSIZE; p < end; p += PGSIZE) {
+        struct page* page;
+        struct frame* frame;
+
+        if (spt_find_page(spt, p) != NULL || (page = vma_materialize(area, p)) == NULL)
+            break;
+        if (vm_share_text(page))
+            continue;
+        frame = frame_alloc(false);
+        if (frame == NULL || !vm_claim_with(page, frame))
+            break;
     }
+    filesys_leave(held);
+    area->around_next = p;
+}
 
-    return vm_do_claim_page(page);
+/* Drop-behind: in a region that madvise() marked sequential, the
+ * FAULT_AROUND_SEQ pages before a fault at VA have been used and
+ * will not be again.  Their frames go where the replacement policy
+ * looks for victims first, so that a long scan evicts itself
+ * rather than the process's other data. */
+static void vm_drop_behind(struct supplemental_page_table* spt, uint8_t* va)
+{
+    struct vm_area* area = vma_find(spt, va);
+    uint8_t* start;
+
+    if (area == NULL || area->advice != MADV_SEQUENTIAL || va == area->start)
+        return;
+    start = (size_t)(va - area->start) > FAULT_AROUND_SEQ * PGSIZE ? va - FAULT_AROUND_SEQ * PGSIZE : area->start;
+
+    lock_acquire(&frame_lock);
+    spt_for_each(spt, start, va, deactivate_page, NULL);
+    lock_release(&frame_lock);
+}
+
+/* Deactivates PAGE's frame, unless it is shared or pinned.  Called
+ * with frame_lock held. */
+static bool deactivate_page(struct page* page, void* aux UNUSED)
+{
+    struct frame* frame = page->frame;
+
+    if (frame != NULL && !frame_is_shared(frame) && !frame->pinned) {
+        frame_accessed(frame, true);
+        replace_deactivate(frame);
+    }
+    return true;
+}
+
+/* MADV_WILLNEED: loads the pages of AREA in [START, END) that
+ * have contents to load, from swap or from the region's file, into
+ * free frames.  Like fault-around, this never evicts; it stops
+ * when no frame is free. */
+static void vm_prefetch(struct vm_area* area, uint8_t* start, uint8_t* end)
+{
+    struct supplemental_page_table* spt = &thread_current()->spt;
+    uint8_t* file_end = area->start + ROUND_UP(area->read_bytes, PGSIZE);
+    bool held = filesys_enter();
+    uint8_t* p;
+
+    for (p = start; p < end; p += PGSIZE) {
+        struct page* page = spt_find_page(spt, p);
+        struct frame* frame;
+
+        /* Untouched pages past the file data are just zeros. */
+        if (page == NULL && (p >= file_end || (page = vma_materialize(area, p)) == NULL))
+            continue;
+        if (page->frame != NULL || vm_share_text(page))
+            continue;
+        frame = frame_alloc(false);
+        if (frame == NULL || !vm_claim_with(page, frame))
+            break;
+    }
+    filesys_leave(held);
+}
+
+/* Gives the kernel ADVICE, an enum madvise_advice, about the
+ * LENGTH bytes at ADDR.  MADV_NORMAL, MADV_RANDOM and
+ * MADV_SEQUENTIAL describe the access pattern; regions are not
+ * split, so the pattern holds for every region the range touches.
+ * MADV_WILLNEED loads the range now and MADV_DONTNEED drops it,
+ * writing dirty file-backed pages back first, so that the next
+ * access finds the region's original contents or zeros.  Returns 0
+ * on success, or -1 if ADDR is not page-aligned, ADVICE is unknown
+ * or no region overlaps the range. */
+int do_madvise(void* addr, size_t length, int advice)
+{
+    struct supplemental_page_table* spt = &thread_current()->spt;
+    uint8_t* start = addr;
+    uint8_t* end = start + ROUND_UP(length, PGSIZE);
+    struct list_elem* e;
+    int result = -1;
+
+    if (pg_ofs(addr) != 0 || end < start || advice < MADV_NORMAL || advice > MADV_DONTNEED)
+        return -1;
+
+    for (e = list_begin(&spt->areas); e != list_end(&spt->areas); e = list_next(e)) {
+        struct vm_area* a = list_entry(e, struct vm_area, elem);
+        uint8_t* s = a->start > start ? a->start : start;
+        uint8_t* t = a->end < end ? a->end : end;
+
+        if (s >= t)
+            continue;
+        switch (advice) {
+        case MADV_WILLNEED:
+            vm_prefetch(a, s, t);
+            break;
+        case MADV_DONTNEED:
+            vm_flush_range(spt, s, t);
+            vm_remove_range(spt, s, t);
+            break;
+        default:
+            a->advice = advice;
+            a->around_next = NULL;
+            a->around_pages = advice == MADV_SEQUENTIAL ? FAULT_AROUND_SEQ : FAULT_AROUND_INIT;
+            break;
+        }
+        result = 0;
+    }
+    return result;
 }
 
 /* Free the page.
@@ -250,7 +1209,10 @@ bool vm_claim_page(void* va)
 
     struct page* page = spt_find_page(&t->spt, va);
     if (page == NULL) {
-        return false;
+        struct vm_area* area = vma_find(&t->spt, va);
+
+        if (area == NULL || (page = vma_materialize(area, va)) == NULL)
+            return false;
     }
 
     if (page->frame != NULL) {
@@ -263,56 +1225,258 @@ bool vm_claim_page(void* va)
 /* Claim the PAGE and set up the mmu. */
 static bool vm_do_claim_page(struct page* page)
 {
+    if (vm_share_text(page))
+        return true;
+
     struct frame* frame = vm_get_frame();
     if (frame == NULL) {
         return false;
     }
-    /* Set links */
-    frame->page = page;
-    page->frame = frame;
+    return vm_claim_with(page, frame);
+}
+
+/* Returns true if PAGE holds read-only code or data of an
+ * executable, which every process running it can share. */
+static bool is_text(struct page* page)
+{
+    struct vm_area* area;
+
+    if (page_get_type(page) != VM_FILE || page->writable)
+        return false;
+    area = vma_find(&page->owner->spt, page->va);
+    return area != NULL && area->kind == VMA_SEGMENT;
+}
+
+/* If PAGE is text that another process already has in a frame,
+ * maps PAGE to that frame and returns true.  Otherwise returns
+ * false, with PAGE's contents still to be loaded. */
+static bool vm_share_text(struct page* page)
+{
+    struct frame* frame;
+    bool ok = false;
+
+    if (!is_text(page))
+        return false;
+    /* Turns the uninit page into a file-backed one; without a
+     * frame, this reads nothing. */
+    if (VM_TYPE(page->operations->type) == VM_UNINIT && !swap_in(page, NULL))
+        return false;
+
+    lock_acquire(&frame_lock);
+    frame = text_lookup(file_get_inode(page->file.file), page->file.offset);
+    /* A pinned frame is still being filled. */
+    if (frame != NULL && !frame->pinned) {
+        frame_link(frame, page);
+        ok = page_map(page);
+        if (!ok)
+            frame_unlink(frame, page);
+    }
+    lock_release(&frame_lock);
+    return ok;
+}
+
+/* Fills pinned FRAME with PAGE's contents, maps it and unpins it.
+ * Frees FRAME if PAGE cannot be read in. */
+static bool vm_claim_with(struct page* page, struct frame* frame)
+{
     if (!is_user_vaddr(page->va)) {
         PANIC("vm_do_claim_page: page->va is kernel address!");
     }
 
+    /* Fill the frame while it is pinned and not yet mapped, so that
+     * neither the evictor nor the process sees it half done. */
+    frame_link(frame, page);
+    if (!swap_in(page, frame->kva)) {
+        lock_acquire(&frame_lock);
+        frame_unlink(frame, page);
+        vm_free_frame(frame);
+        lock_release(&frame_lock);
+        return false;
+    }
+
     /* Insert page table entry to map page's VA to frame's PA. */
-    if (!pml4_set_page(thread_current()->pml4, page->va, frame->kva, true))
+    if (!page_map(page))
         PANIC("pml4_set_page failed");
 
-    return swap_in(page, frame->kva);
+    lock_acquire(&frame_lock);
+    if (is_text(page))
+        text_insert(frame, file_get_inode(page->file.file), page->file.offset);
+    replace_add(frame);
+    frame->pinned = false;
+    lock_release(&frame_lock);
+    return true;
 }
 
 /* Initialize new supplemental page table */
 void supplemental_page_table_init(struct supplemental_page_table* spt)
 {
-    hash_init(&spt->pages, spt_hash, spt_hash_less, NULL);
+    ASSERT(spt == &thread_current()->spt);
+
+    fault_stat_init(thread_current());
+    spt_init(spt);
+    vma_init(spt);
 }
 
 /* Copy supplemental page table from src to dst */
-bool supplemental_page_table_copy(struct supplemental_page_table* dst UNUSED,
-                                  struct supplemental_page_table* src UNUSED)
+bool supplemental_page_table_copy(struct supplemental_page_table* dst, struct supplemental_page_table* src)
+{
+    ASSERT(dst == &thread_current()->spt);
+
+    return vma_copy_all(dst, src) && spt_for_each(src, NULL, (void*)KERN_BASE, copy_page, dst);
+}
+
+/* Duplicates PAGE, from the parent, into the current process.
+ * Anonymous pages are shared copy-on-write: the child's page uses
+ * the parent's frame, or swap slot, and neither may write to it
+ * until vm_handle_wp() gives the writer its own copy. */
+static bool copy_page(struct page* page, void* aux UNUSED)
+{
+    enum vm_type type = VM_TYPE(page->operations->type);
+    struct page* child;
+
+    /* Pages not loaded yet, file pages that are not resident, and
+     * text, which the child finds shared, are made again from the
+     * child's own regions when it touches them. */
+    if (type == VM_UNINIT || (type == VM_FILE && (page->frame == NULL || is_text(page))))
+        return true;
+    if (type == VM_FILE)
+        return vm_alloc_page_with_initializer(type, page->va, page->writable, copy_init, page)
+               && vm_claim_page(page->va);
+
+    if (!vm_alloc_page(VM_ANON, page->va, page->writable))
+        return false;
+    child = spt_find_page(&thread_current()->spt, page->va);
+    /* Turns the uninit page into an anonymous one; with no
+     * initializer, this does not touch the frame. */
+    if (!swap_in(child, NULL))
+        return false;
+
+    lock_acquire(&frame_lock);
+    if (page->frame != NULL) {
+        frame_link(page->frame, child);
+        if (!page_map(child)) {
+            frame_unlink(page->frame, child);
+            lock_release(&frame_lock);
+            return false;
+        }
+        page_map(page);
+    } else
+        anon_swap_dup(child, page);
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Fills the child's file-backed PAGE, which its initializer has
+ * already read from the file, with the contents of the parent's
+ * page AUX, if that is still resident and so may be newer. */
+static bool copy_init(struct page* page, void* aux)
 {
+    struct page* parent = aux;
+
+    lock_acquire(&frame_lock);
+    if (parent->frame != NULL)
+        memcpy(page->frame->kva, parent->frame->kva, PGSIZE);
+    lock_release(&frame_lock);
+    return true;
 }
 
 /* Free the resource hold by the supplemental page table */
-void supplemental_page_table_kill(struct supplemental_page_table* spt UNUSED)
+void supplemental_page_table_kill(struct supplemental_page_table* spt)
 {
-    /* TODO: Destroy all the supplemental_page_table hold by thread and
-     * TODO: writeback all the modified contents to the storage. */
+    vm_flush_range(spt, NULL, (void*)KERN_BASE);
+    vm_remove_range(spt, NULL, (void*)KERN_BASE);
+    vma_destroy_all(spt);
 }
 
-/* 구조체의 멤버를 이용해서 같은 버킷에 저장하도록 하는 장치 */
-static uint64_t spt_hash(const struct hash_elem* e, void* aux)
+/* Writes every dirty file-backed page of SPT in [START, END) back
+ * to its file. */
+void vm_flush_range(struct supplemental_page_table* spt, void* start, void* end)
 {
-    const struct page* page = hash_entry(e, struct page, elem);
+    bool held = filesys_enter();
 
-    return hash_bytes(&page->va, sizeof page->va);
+    spt_for_each(spt, start, end, flush_page, NULL);
+    filesys_leave(held);
 }
 
-/* 해시 값이 충돌했을 때, 버킷 내에서 같은 키인지 다른 키인지 가려주는 장치 */
-static bool spt_hash_less(const struct hash_elem* a, const struct hash_elem* b, void* aux)
+/* Removes every page of SPT in [START, END), without writing it
+ * back. */
+void vm_remove_range(struct supplemental_page_table* spt, void* start, void* end)
 {
-    const struct page* page_a = hash_entry(a, struct page, elem);
-    const struct page* page_b = hash_entry(b, struct page, elem);
+    spt_for_each(spt, start, end, kill_page, spt);
+}
 
-    return &page_a->va < &page_b->va;
+/* Writes PAGE back if it is a dirty file-backed page.  Called with
+ * filesys_lock held. */
+static bool flush_page(struct page* page, void* aux UNUSED)
+{
+    if (VM_TYPE(page->operations->type) != VM_FILE)
+        return true;
+    lock_acquire(&frame_lock);
+    file_page_flush(page);
+    lock_release(&frame_lock);
+    return true;
+}
+
+/* Orders frames by the file position of their page. */
+static int frame_file_less(const void* a_, const void* b_)
+{
+    const struct file_page* a = &frame_page(*(struct frame* const*)a_)->file;
+    const struct file_page* b = &frame_page(*(struct frame* const*)b_)->file;
+    struct inode* ia = file_get_inode(a->file);
+    struct inode* ib = file_get_inode(b->file);
+
+    if (ia != ib)
+        return ia < ib ? -1 : 1;
+    return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+/* Writes back up to FLUSH_BATCH dirty file-backed frames, by file
+ * and ascending offset so the disk sees sequential writes.  Returns
+ * the number written; when that is FLUSH_BATCH, more may be left. */
+size_t vm_flush_frames(void)
+{
+    struct frame* batch[FLUSH_BATCH];
+    size_t frame_cnt, cnt = 0, i;
+
+    lock_acquire(&filesys_lock);
+    lock_acquire(&frame_lock);
+    frame_cnt = bitmap_size(frame_table);
+    for (i = 0; i < frame_cnt && cnt < FLUSH_BATCH; i++) {
+        struct frame* frame = &frames[i];
+        struct page* page;
+
+        if (!bitmap_test(frame_table, i) || frame->ref_cnt == 0 || frame->pinned)
+            continue;
+        page = frame_page(frame);
+        if (VM_TYPE(page->operations->type) == VM_FILE && pml4_is_dirty(page->owner->pml4, page->va))
+            batch[cnt++] = frame;
+    }
+    qsort(batch, cnt, sizeof *batch, frame_file_less);
+    for (i = 0; i < cnt; i++)
+        file_page_flush(frame_page(batch[i]));
+    lock_release(&frame_lock);
+    lock_release(&filesys_lock);
+    return cnt;
+}
+
+/* Unmaps PAGE, drops its use of its frame, freeing the frame if
+ * no one else uses it, and removes it from SPT (AUX).  frame_lock
+ * keeps the evictor away from the page meanwhile. */
+static bool kill_page(struct page* page, void* spt)
+{
+    struct frame* frame;
+
+    lock_acquire(&frame_lock);
+    frame = page->frame;
+    if (frame != NULL) {
+        pml4_clear_page(page->owner->pml4, page->va);
+        rmap_remove(frame, page);
+    }
+    replace_forget(page);
+    /* destroy() may still need the frame. */
+    spt_remove_page(spt, page);
+    if (frame != NULL && frame->ref_cnt == 0 && frame != &zero_frame)
+        vm_free_frame(frame);
+    lock_release(&frame_lock);
+    return true;
 }
@@ -0,0 +1,232 @@
+/* vma.c: Virtual memory regions.
+ *
+ * exec, the stack and mmap describe what they map with one
+ * struct vm_area each, instead of allocating a struct page up
+ * front for every page.  When an address in a region faults for
+ * the first time, vma_materialize() creates its page, which then
+ * fills itself from the region's file (or with zeros) in
+ * vma_load_page(). */
+
+#include "vm/vma.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+#include "userprog/syscall.h"
+#include "vm/vm.h"
+
+static bool vma_load_page(struct page* page, void* aux);
+
+/* Initializes SPT's region list as empty. */
+void vma_init(struct supplemental_page_table* spt)
+{
+    list_init(&spt->areas);
+    spt->area_hint = NULL;
+}
+
+/* Creates a region of KIND for the LENGTH bytes at START, whose
+ * pages are of TYPE and read-only unless WRITABLE.  The region is
+ * zero-filled until vma_set_file() gives it a backing file.
+ * Returns the region, or a null pointer if it would overlap an
+ * existing one or memory runs out. */
+struct vm_area* vma_create(struct supplemental_page_table* spt, void* start, size_t length, enum vma_kind kind,
+                           enum vm_type type, bool writable)
+{
+    uint8_t* end = (uint8_t*)start + ROUND_UP(length, PGSIZE);
+    struct vm_area* area;
+    struct list_elem* e;
+
+    ASSERT(pg_ofs(start) == 0);
+    ASSERT(length > 0);
+
+    if (!is_user_vaddr(start) || !is_user_vaddr(end - 1) || end <= (uint8_t*)start)
+        return NULL;
+
+    /* Keep the list sorted by address; refuse overlaps. */
+    for (e = list_begin(&spt->areas); e != list_end(&spt->areas); e = list_next(e)) {
+        struct vm_area* a = list_entry(e, struct vm_area, elem);
+
+        if (a->start >= end)
+            break;
+        if (a->end > (uint8_t*)start)
+            return NULL;
+    }
+
+    area = malloc(sizeof *area);
+    if (area == NULL)
+        return NULL;
+    area->start = start;
+    area->end = end;
+    area->file = NULL;
+    area->offset = 0;
+    area->read_bytes = 0;
+    area->writable = writable;
+    area->type = type;
+    area->kind = kind;
+    area->around_next = NULL;
+    area->around_pages = FAULT_AROUND_INIT;
+    area->advice = MADV_NORMAL;
+    list_insert(e, &area->elem);
+    return area;
+}
+
+/* Backs AREA with the READ_BYTES bytes of FILE starting at OFFSET.
+ * AREA keeps its own handle to FILE.  Returns false if memory
+ * runs out. */
+bool vma_set_file(struct vm_area* area, struct file* file, off_t offset, size_t read_bytes)
+{
+    ASSERT(area->file == NULL);
+    ASSERT(read_bytes <= (size_t)(area->end - area->start));
+
+    bool held = filesys_enter();
+
+    area->file = file_reopen(file);
+    filesys_leave(held);
+    if (area->file == NULL)
+        return false;
+    area->offset = offset;
+    area->read_bytes = read_bytes;
+    return true;
+}
+
+/* Returns the region that contains VA, or a null pointer. */
+struct vm_area* vma_find(struct supplemental_page_table* spt, const void* va)
+{
+    struct vm_area* hint = spt->area_hint;
+    struct list_elem* e;
+
+    if (hint != NULL && (uint8_t*)va >= hint->start && (uint8_t*)va < hint->end)
+        return hint;
+
+    for (e = list_begin(&spt->areas); e != list_end(&spt->areas); e = list_next(e)) {
+        struct vm_area* a = list_entry(e, struct vm_area, elem);
+
+        if ((uint8_t*)va < a->start)
+            break;
+        if ((uint8_t*)va < a->end) {
+            spt->area_hint = a;
+            return a;
+        }
+    }
+    return NULL;
+}
+
+/* Creates the page for VA in AREA, in the current process.  Its
+ * contents are filled in when the page is claimed.  Returns the
+ * page, or a null pointer if memory runs out. */
+struct page* vma_materialize(struct vm_area* area, void* va)
+{
+    struct supplemental_page_table* spt = &thread_current()->spt;
+
+    va = pg_round_down(va);
+    ASSERT((uint8_t*)va >= area->start && (uint8_t*)va < area->end);
+
+    /* File-backed pages read themselves in when initialized. */
+    if (!vm_alloc_page_with_initializer(area->type, va, area->writable, area->type == VM_FILE ? NULL : vma_load_page,
+                                        area))
+        return NULL;
+    return spt_find_page(spt, va);
+}
+
+/* Fills PAGE from its region AUX: file data up to the region's
+ * READ_BYTES, zeros after. */
+static bool vma_load_page(struct page* page, void* aux)
+{
+    struct vm_area* area = aux;
+    uint8_t* kva = page->frame->kva;
+    size_t ofs = (uint8_t*)page->va - area->start;
+    size_t read_bytes = 0;
+
+    if (ofs < area->read_bytes)
+        read_bytes = area->read_bytes - ofs < PGSIZE ? area->read_bytes - ofs : PGSIZE;
+
+    if (read_bytes > 0) {
+        bool held = filesys_enter();
+        bool ok = file_read_at(area->file, kva, read_bytes, area->offset + ofs) == (off_t)read_bytes;
+
+        filesys_leave(held);
+        if (!ok)
+            return false;
+    }
+    memset(kva + read_bytes, 0, PGSIZE - read_bytes);
+    return true;
+}
+
+/* Extends the stack region down to cover VA, if that keeps the
+ * stack within STACK_MAX.  Returns true if VA is now inside the
+ * stack region. */
+bool vma_grow_stack(struct supplemental_page_table* spt, void* va)
+{
+    struct list_elem* e;
+    struct vm_area* stack = NULL;
+    uint8_t* new_start = pg_round_down(va);
+
+    if ((uint8_t*)va >= (uint8_t*)USER_STACK || (uint8_t*)va < (uint8_t*)USER_STACK - STACK_MAX)
+        return false;
+
+    for (e = list_rbegin(&spt->areas); e != list_rend(&spt->areas); e = list_prev(e)) {
+        struct vm_area* a = list_entry(e, struct vm_area, elem);
+
+        if (a->kind == VMA_STACK) {
+            stack = a;
+            break;
+        }
+    }
+    if (stack == NULL)
+        return false;
+    if (new_start >= stack->start)
+        return true;
+
+    /* Must not run into the region below. */
+    e = list_prev(&stack->elem);
+    if (e != list_head(&spt->areas) && list_entry(e, struct vm_area, elem)->end > new_start)
+        return false;
+
+    stack->start = new_start;
+    return true;
+}
+
+/* Removes AREA from SPT and frees it.  Pages already created for
+ * it are not touched. */
+void vma_destroy(struct supplemental_page_table* spt, struct vm_area* area)
+{
+    if (spt->area_hint == area)
+        spt->area_hint = NULL;
+    list_remove(&area->elem);
+    if (area->file != NULL) {
+        bool held = filesys_enter();
+
+        file_close(area->file);
+        filesys_leave(held);
+    }
+    free(area);
+}
+
+/* Destroys every region of SPT. */
+void vma_destroy_all(struct supplemental_page_table* spt)
+{
+    while (!list_empty(&spt->areas))
+        vma_destroy(spt, list_entry(list_front(&spt->areas), struct vm_area, elem));
+}
+
+/* Gives DST a copy of each region of SRC.  Returns false if
+ * memory runs out. */
+bool vma_copy_all(struct supplemental_page_table* dst, struct supplemental_page_table* src)
+{
+    struct list_elem* e;
+
+    for (e = list_begin(&src->areas); e != list_end(&src->areas); e = list_next(e)) {
+        struct vm_area* a = list_entry(e, struct vm_area, elem);
+        struct vm_area* copy = vma_create(dst, a->start, a->end - a->start, a->kind, a->type, a->writable);
+
+        if (copy == NULL)
+            return false;
+        copy->advice = a->advice;
+        copy->around_pages = a->around_pages;
+        if (a->file != NULL && !vma_set_file(copy, a->file, a->offset, a->read_bytes))
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,494 @@
+/* zswap.c: Compressed cache in front of the swap disk.
+ *
+ * Each page anon.c writes to a swap slot is first offered here.
+ * A page whose 64-bit words are all the same (most often zero) is
+ * kept as that one word.  Any other page is compressed with a
+ * small LZ77 coder and, if the result is at most ZSWAP_MAX_LEN
+ * bytes, kept in a pool of pages carved into size classes.  Only
+ * pages that do not compress go to the disk right away.
+ *
+ * The pool holds at most max_pages pages.  When it is full, the
+ * entries stored longest ago are decompressed and written to the
+ * disk slot they already own, oldest first, until the new page
+ * fits.  Since a cached page keeps its slot, sharing and freeing of
+ * slots in anon.c work the same whether a page is here or on disk.
+ *
+ * The cap defaults to a fifth of the user pool and can be set at
+ * boot with -zswap=PAGES; 0 turns the cache off. */
+
+#include "vm/zswap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/vmalloc.h"
+
+/* Default cap, as a fraction of the user pool. */
+#define ZSWAP_DEFAULT_DIV 5
+
+/* Size classes are multiples of ZCLASS_STEP bytes.  The largest
+ * still fits twice in a pool page, and a page that does not
+ * compress below it is not worth keeping. */
+#define ZCLASS_STEP 64
+#define ZCLASS_CNT 31
+#define ZSWAP_MAX_LEN (ZCLASS_STEP * ZCLASS_CNT)
+
+/* LZ77 coder: 4-byte matches found through a hash table of
+ * recent positions. */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 12
+
+/* Header at the start of every pool page.  The rest of the page
+ * is objects of the page's class. */
+struct zpage {
+    struct list_elem elem; /* In its class's list, while it has room. */
+    void* free;            /* Free objects, linked through their first word. */
+    uint16_t used;         /* Objects handed out. */
+    uint16_t class;        /* Index into classes[]. */
+};
+
+/* A cached page. */
+struct zswap_entry {
+    struct list_elem lru_elem; /* In zswap_lru, if LEN > 0. */
+    size_t slot;               /* Swap slot the page belongs to. */
+    size_t len;                /* Compressed length, or 0 if same-filled. */
+    union {
+        void* data;    /* Compressed contents, if LEN > 0. */
+        uint64_t fill; /* Every word of the page, if LEN is 0. */
+    };
+};
+
+static size_t max_pages = SIZE_MAX; /* SIZE_MAX until set or defaulted. */
+static void (*write_slot)(size_t slot, const void* kva);
+
+static struct lock zswap_lock;
+static struct zswap_entry** entries; /* Indexed by swap slot. */
+static size_t entries_pages;         /* Pages backing ENTRIES, from vmalloc(). */
+static struct list zswap_lru;        /* Pooled entries, oldest first. */
+static struct list classes[ZCLASS_CNT];
+static size_t pool_pages, pool_peak;
+
+/* Scratch space, used with zswap_lock held. */
+static uint16_t lz_table[1 << LZ_HASH_BITS];
+static uint8_t* out_buf;    /* Compressor output. */
+static uint8_t* bounce_buf; /* Decompressed page on its way to disk. */
+
+/* Statistics. */
+static long long store_cnt, same_cnt, reject_cnt, writeback_cnt, hit_cnt, miss_cnt;
+static long long bytes_in, bytes_out;
+static size_t entry_cnt;
+
+static void zswap_writeback(struct zswap_entry* e);
+static void entry_free(struct zswap_entry* e);
+
+/* Caps the pool at PAGES pages.  0 disables the cache. */
+void zswap_set_max_pages(size_t pages)
+{
+    max_pages = pages;
+}
+
+/* Sets up the cache for a swap device of SLOT_CNT slots.  Pages
+ * pushed out of the pool are written with WRITEBACK. */
+void zswap_init(size_t slot_cnt, void (*writeback)(size_t slot, const void* kva))
+{
+    size_t i;
+
+    if (max_pages == SIZE_MAX)
+        max_pages = palloc_pool_pages(PAL_USER) / ZSWAP_DEFAULT_DIV;
+    if (slot_cnt == 0 || max_pages == 0) {
+        max_pages = 0;
+        return;
+    }
+
+    lock_init(&zswap_lock);
+    list_init(&zswap_lru);
+    for (i = 0; i < ZCLASS_CNT; i++)
+        list_init(&classes[i]);
+    entries_pages = DIV_ROUND_UP(slot_cnt * sizeof *entries, PGSIZE);
+    entries = vmalloc(PAL_ASSERT | PAL_ZERO, entries_pages);
+    out_buf = palloc_get_page(PAL_ASSERT);
+    bounce_buf = palloc_get_page(PAL_ASSERT);
+    write_slot = writeback;
+}
+
+/* LZ77 coder.  The output is a series of sequences, each a token
+ * byte, literal bytes and, except in the last, a match:
+ *
+ *   token      high nibble: literal count, low nibble: match
+ *              length minus LZ_MIN_MATCH; 15 means more follows
+ *   [count]    for a nibble of 15, bytes added to it until one
+ *              is not 255
+ *   literals
+ *   offset     2 bytes, little endian: how far back the match is
+ *   [length]   as for the literal count */
+
+static uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+static size_t lz_hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends the bytes for a count of N beyond a nibble of 15 to DST
+ * at *OP.  Returns false if that would pass CAP. */
+static bool lz_put_count(uint8_t* dst, size_t* op, size_t cap, size_t n)
+{
+    for (; n >= 255; n -= 255) {
+        if (*op >= cap)
+            return false;
+        dst[(*op)++] = 255;
+    }
+    if (*op >= cap)
+        return false;
+    dst[(*op)++] = n;
+    return true;
+}
+
+/* Appends a sequence of the LIT_CNT bytes at LIT and, unless
+ * MATCH_LEN is 0, a match of MATCH_LEN bytes OFFSET back.  Returns
+ * false if the output would pass CAP. */
+static bool lz_put_sequence(uint8_t* dst, size_t* op, size_t cap, const uint8_t* lit, size_t lit_cnt,
+                            size_t match_len, size_t offset)
+{
+    size_t m = match_len > 0 ? match_len - LZ_MIN_MATCH : 0;
+
+    if (*op >= cap)
+        return false;
+    dst[(*op)++] = (lit_cnt < 15 ? lit_cnt : 15) << 4 | (m < 15 ? m : 15);
+    if (lit_cnt >= 15 && !lz_put_count(dst, op, cap, lit_cnt - 15))
+        return false;
+    if (*op + lit_cnt > cap)
+        return false;
+    memcpy(dst + *op, lit, lit_cnt);
+    *op += lit_cnt;
+
+    if (match_len == 0)
+        return true;
+    if (*op + 2 > cap)
+        return false;
+    dst[(*op)++] = offset & 0xff;
+    dst[(*op)++] = offset >> 8;
+    return m < 15 || lz_put_count(dst, op, cap, m - 15);
+}
+
+/* Compresses the PGSIZE bytes at SRC into DST.  Returns the
+ * compressed length, or 0 if it would be more than CAP. */
+static size_t lz_compress(const uint8_t* src, uint8_t* dst, size_t cap)
+{
+    size_t ip = 0, anchor = 0, op = 0;
+
+    memset(lz_table, 0, sizeof lz_table);
+    while (ip + LZ_MIN_MATCH <= PGSIZE) {
+        uint32_t v = read32(src + ip);
+        size_t h = lz_hash(v);
+        size_t cand = lz_table[h];
+        size_t len;
+
+        lz_table[h] = ip;
+        if (cand >= ip || read32(src + cand) != v) {
+            ip++;
+            continue;
+        }
+        for (len = LZ_MIN_MATCH; ip + len < PGSIZE && src[cand + len] == src[ip + len]; len++)
+            continue;
+        if (!lz_put_sequence(dst, &op, cap, src + anchor, ip - anchor, len, ip - cand))
+            return 0;
+        ip += len;
+        anchor = ip;
+    }
+    if (!lz_put_sequence(dst, &op, cap, src + anchor, PGSIZE - anchor, 0, 0))
+        return 0;
+    return op;
+}
+
+/* Reads a count that continues a nibble of 15 from SRC at *IP. */
+static size_t lz_get_count(const uint8_t* src, size_t* ip)
+{
+    size_t n = 0;
+
+    while (src[*ip] == 255)
+        n += src[(*ip)++];
+    return n + src[(*ip)++];
+}
+
+/* Decompresses the LEN bytes at SRC into the page at DST. */
+static void lz_decompress(const uint8_t* src, size_t len, uint8_t* dst)
+{
+    size_t ip = 0, op = 0;
+
+    while (ip < len) {
+        uint8_t token = src[ip++];
+        size_t lit_cnt = token >> 4;
+        size_t match_len = token & 15;
+        size_t offset;
+
+        if (lit_cnt == 15)
+            lit_cnt += lz_get_count(src, &ip);
+        ASSERT(op + lit_cnt <= PGSIZE);
+        memcpy(dst + op, src + ip, lit_cnt);
+        ip += lit_cnt;
+        op += lit_cnt;
+        if (ip >= len)
+            break;
+
+        offset = src[ip] | src[ip + 1] << 8;
+        ip += 2;
+        if (match_len == 15)
+            match_len += lz_get_count(src, &ip);
+        match_len += LZ_MIN_MATCH;
+        ASSERT(offset > 0 && offset <= op && op + match_len <= PGSIZE);
+
+        /* Byte by byte: the match may overlap what it produces. */
+        for (; match_len > 0; match_len--, op++)
+            dst[op] = dst[op - offset];
+    }
+    ASSERT(op == PGSIZE);
+}
+
+/* Size-class pool. */
+
+/* Returns the size of objects of class CLASS. */
+static size_t class_size(size_t class)
+{
+    return (class + 1) * ZCLASS_STEP;
+}
+
+/* Takes a new page for CLASS, if the cap allows. */
+static struct zpage* zpage_create(size_t class)
+{
+    size_t size = class_size(class);
+    struct zpage* zp;
+    uint8_t* obj;
+
+    if (pool_pages >= max_pages || (zp = palloc_get_page(0)) == NULL)
+        return NULL;
+    zp->class = class;
+    zp->used = 0;
+    zp->free = NULL;
+    for (obj = (uint8_t*)(zp + 1); obj + size <= (uint8_t*)zp + PGSIZE; obj += size) {
+        *(void**)obj = zp->free;
+        zp->free = obj;
+    }
+    list_push_back(&classes[class], &zp->elem);
+    if (++pool_pages > pool_peak)
+        pool_peak = pool_pages;
+    return zp;
+}
+
+/* Returns an object of at least LEN bytes, or a null pointer if
+ * the pool is full. */
+static void* zpool_alloc(size_t len)
+{
+    size_t class = (len - 1) / ZCLASS_STEP;
+    struct zpage* zp;
+    void* obj;
+
+    ASSERT(len > 0 && len <= ZSWAP_MAX_LEN);
+    if (!list_empty(&classes[class]))
+        zp = list_entry(list_front(&classes[class]), struct zpage, elem);
+    else if ((zp = zpage_create(class)) == NULL)
+        return NULL;
+
+    obj = zp->free;
+    zp->free = *(void**)obj;
+    zp->used++;
+    if (zp->free == NULL)
+        list_remove(&zp->elem);
+    return obj;
+}
+
+/* Returns OBJ to the pool, and its page to palloc once empty. */
+static void zpool_free(void* obj)
+{
+    struct zpage* zp = pg_round_down(obj);
+
+    if (zp->free == NULL)
+        list_push_back(&classes[zp->class], &zp->elem);
+    *(void**)obj = zp->free;
+    zp->free = obj;
+    if (--zp->used == 0) {
+        list_remove(&zp->elem);
+        palloc_free_page(zp);
+        pool_pages--;
+    }
+}
+
+/* Returns the word every 64-bit word of the page at KVA holds, in
+ * *FILL, if there is one. */
+static bool page_same_filled(const void* kva, uint64_t* fill)
+{
+    const uint64_t* w = kva;
+    size_t i;
+
+    for (i = 1; i < PGSIZE / sizeof *w; i++)
+        if (w[i] != w[0])
+            return false;
+    *fill = w[0];
+    return true;
+}
+
+/* Keeps the page at KVA, which is being swapped out to SLOT.
+ * Returns false, leaving the page for the disk, if the cache is
+ * off, the page does not compress, or there is no room. */
+bool zswap_store(size_t slot, const void* kva)
+{
+    struct zswap_entry* e;
+    uint64_t fill;
+    size_t len;
+
+    if (max_pages == 0)
+        return false;
+
+    e = malloc(sizeof *e);
+    if (e == NULL)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    ASSERT(entries[slot] == NULL);
+    if (page_same_filled(kva, &fill)) {
+        e->len = 0;
+        e->fill = fill;
+        same_cnt++;
+        bytes_out += sizeof fill;
+    } else {
+        len = lz_compress(kva, out_buf, ZSWAP_MAX_LEN);
+        if (len == 0)
+            goto reject;
+
+        /* Make room by pushing the oldest entries to disk. */
+        while ((e->data = zpool_alloc(len)) == NULL) {
+            if (list_empty(&zswap_lru))
+                goto reject;
+            zswap_writeback(list_entry(list_front(&zswap_lru), struct zswap_entry, lru_elem));
+        }
+        memcpy(e->data, out_buf, len);
+        e->len = len;
+        list_push_back(&zswap_lru, &e->lru_elem);
+        bytes_out += len;
+    }
+    e->slot = slot;
+    entries[slot] = e;
+    entry_cnt++;
+    store_cnt++;
+    bytes_in += PGSIZE;
+    lock_release(&zswap_lock);
+    return true;
+
+reject:
+    reject_cnt++;
+    lock_release(&zswap_lock);
+    free(e);
+    return false;
+}
+
+/* Copies the page cached for SLOT into KVA.  The entry stays until
+ * zswap_invalidate().  Returns false if SLOT is not cached, so its
+ * contents are on disk. */
+bool zswap_load(size_t slot, void* kva)
+{
+    struct zswap_entry* e;
+
+    if (max_pages == 0)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    e = entries[slot];
+    if (e == NULL) {
+        miss_cnt++;
+        lock_release(&zswap_lock);
+        return false;
+    }
+    if (e->len == 0) {
+        uint64_t* w = kva;
+        size_t i;
+
+        for (i = 0; i < PGSIZE / sizeof *w; i++)
+            w[i] = e->fill;
+    } else
+        lz_decompress(e->data, e->len, kva);
+    hit_cnt++;
+    lock_release(&zswap_lock);
+    return true;
+}
+
+/* Returns true if SLOT's page is cached here, in which case the
+ * disk slot does not hold it. */
+bool zswap_contains(size_t slot)
+{
+    bool found;
+
+    if (max_pages == 0)
+        return false;
+
+    lock_acquire(&zswap_lock);
+    found = entries[slot] != NULL;
+    lock_release(&zswap_lock);
+    return found;
+}
+
+/* Drops whatever is cached for SLOT, which is being freed. */
+void zswap_invalidate(size_t slot)
+{
+    if (max_pages == 0)
+        return;
+
+    lock_acquire(&zswap_lock);
+    if (entries[slot] != NULL)
+        entry_free(entries[slot]);
+    lock_release(&zswap_lock);
+}
+
+/* Prints cache statistics.  The ratio is of the bytes of pages
+ * stored to the bytes they were kept in. */
+void zswap_print_stats(void)
+{
+    long long ratio = bytes_out > 0 ? bytes_in * 100 / bytes_out : 0;
+    long long loads = hit_cnt + miss_cnt;
+
+    printf("Zswap: %zu pages in %zu pool pages (peak %zu, cap %zu), %lld stores (%lld same-filled), "
+           "%lld rejects, %lld writebacks\n",
+           entry_cnt, pool_pages, pool_peak, max_pages, store_cnt, same_cnt, reject_cnt, writeback_cnt);
+    printf("Zswap: compression ratio %lld.%02lld, %lld hits, %lld misses (%lld%% hit rate)\n", ratio / 100,
+           ratio % 100, hit_cnt, miss_cnt, loads > 0 ? hit_cnt * 100 / loads : 0);
+}
+
+/* Writes pooled entry E to its disk slot and drops it.  Must be
+ * called with zswap_lock held, which keeps loads of E's slot
+ * waiting until the disk has the page. */
+static void zswap_writeback(struct zswap_entry* e)
+{
+    ASSERT(lock_held_by_current_thread(&zswap_lock));
+    ASSERT(e->len > 0);
+
+    lz_decompress(e->data, e->len, bounce_buf);
+    write_slot(e->slot, bounce_buf);
+    writeback_cnt++;
+    entry_free(e);
+}
+
+/* Removes E from the cache and frees it.  Must be called with
+ * zswap_lock held. */
+static void entry_free(struct zswap_entry* e)
+{
+    ASSERT(entries[e->slot] == e);
+
+    entries[e->slot] = NULL;
+    if (e->len > 0) {
+        list_remove(&e->lru_elem);
+        zpool_free(e->data);
+    }
+    entry_cnt--;
+    free(e);
+}